@@ -0,0 +1,209 @@
+/* Copyright Phillip Potter, 2019 under MIT License */
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <map>
+#include "gp_parser.h"
+
+namespace gp_parser {
+
+// Define the state behind a batch parser, shared between the caller and the
+// workers
+struct BatchParser::State {
+	// A single tab to be parsed - buffers are borrowed, so they must
+	// outlive the batch parser
+	struct Job {
+		std::size_t index;
+		std::string path;
+		bool fromBuffer;
+		const std::byte *data;
+		std::size_t size;
+	};
+
+	BatchOptions options;
+	std::vector<Job> jobs;
+	std::size_t nextJob = 0;
+	std::size_t maxPending = 0;
+	bool stopping = false;
+	std::mutex resultMutex;
+	std::condition_variable resultReady;
+	std::condition_variable jobReady;
+	std::map<std::size_t, BatchResult> results;
+	std::size_t delivered = 0;
+	std::vector<std::thread> workers;
+
+	explicit State(const BatchOptions& options) : options(options) {}
+
+	void start();
+	void stop();
+	void work();
+};
+
+/* This constructor starts parsing the supplied tab files straight away */
+BatchParser::BatchParser(const std::vector<std::string>& paths, const BatchOptions& options)
+	: state(new State(options))
+{
+	for (std::size_t i = 0; i < paths.size(); ++i) {
+		// A file which cannot be sized is left to fail when it is opened
+		std::error_code error;
+		auto size = std::filesystem::file_size(paths[i], error);
+		state->jobs.push_back(State::Job{i, paths[i], false, nullptr, error ? 0 : static_cast<std::size_t>(size)});
+	}
+
+	state->start();
+}
+
+/* This constructor starts parsing the supplied in-memory tab files straight
+ * away - the bytes are not copied, so they must outlive the batch parser */
+BatchParser::BatchParser(const std::vector<std::vector<char>>& buffers, const BatchOptions& options)
+	: state(new State(options))
+{
+	for (std::size_t i = 0; i < buffers.size(); ++i)
+		state->jobs.push_back(State::Job{i, std::string(), true, reinterpret_cast<const std::byte *>(buffers[i].data()), buffers[i].size()});
+
+	state->start();
+}
+
+/* This stops the workers once they have finished the tabs they are on */
+BatchParser::~BatchParser()
+{
+	state->stop();
+}
+
+/* This hands back the next result, waiting for it if need be, and returns
+ * false once every result has been handed back */
+bool BatchParser::next(BatchResult& result)
+{
+	std::unique_lock<std::mutex> lock(state->resultMutex);
+	if (state->delivered == state->jobs.size())
+		return false;
+
+	state->resultReady.wait(lock, [this] {
+		return !state->results.empty() &&
+		       (!state->options.inputOrder || state->results.begin()->first == state->delivered);
+	});
+	auto entry = state->results.begin();
+	result = std::move(entry->second);
+	state->results.erase(entry);
+	++state->delivered;
+	lock.unlock();
+	state->jobReady.notify_one();
+
+	return true;
+}
+
+/* This orders the jobs and starts the workers. Every worker claims the next
+ * job from a shared counter as soon as it is free, which balances the load
+ * as well as work stealing would, since the jobs are independent and there
+ * is only one counter to contend on. Unless the results are wanted in the
+ * order of the input, the largest tabs are taken first, so that a big tab
+ * cannot be left until the end, holding up the whole batch - in input order
+ * the jobs are left as they are, so that the results needed next are always
+ * the ones being parsed */
+void BatchParser::State::start()
+{
+	if (!options.inputOrder) {
+		std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) {
+			return a.size > b.size;
+		});
+	}
+
+	auto threadCount = options.threadCount;
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	maxPending = options.maxPendingResults > 0 ? options.maxPendingResults : threadCount * 2;
+	threadCount = std::min(threadCount, jobs.size());
+	try {
+		for (std::size_t t = 0; t < threadCount; ++t)
+			workers.emplace_back(&State::work, this);
+	} catch (...) {
+		// The destructor is not run when a constructor throws
+		stop();
+		throw;
+	}
+}
+
+/* This stops the workers once they have finished the tabs they are on, and
+ * waits for them */
+void BatchParser::State::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(resultMutex);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+/* This is run by each worker, parsing tabs until there are none left. A job
+ * is only claimed while fewer than the maximum number of results are pending,
+ * counting those still being parsed - in input order this also keeps the
+ * results waiting on an earlier tab to within the same window */
+void BatchParser::State::work()
+{
+	// Each worker keeps a single parser, so that its storage is reused from
+	// one tab to the next and failures are reported without throwing
+	Parser parser(options.parseOptions);
+	while (true) {
+		std::size_t j;
+		{
+			std::unique_lock<std::mutex> lock(resultMutex);
+			jobReady.wait(lock, [this] {
+				return stopping || nextJob == jobs.size() || nextJob - delivered < maxPending;
+			});
+			if (stopping || nextJob == jobs.size())
+				return;
+			j = nextJob++;
+		}
+
+		auto& job = jobs[j];
+		auto result = BatchResult();
+		result.index = job.index;
+		result.path = job.path;
+		if (job.fromBuffer) {
+			// An empty buffer need not have any storage behind it, so point
+			// it at a byte of its own to be read as truncated
+			static const std::byte emptyBuffer{};
+			result.parseResult = parser.tryParse(job.data != nullptr ? job.data : &emptyBuffer, job.size);
+		} else {
+			result.parseResult = parser.tryParse(job.path.c_str());
+		}
+		result.succeeded = result.parseResult.succeeded();
+		if (result.succeeded)
+			result.song = parser.takeSong();
+		else
+			result.error = getName(result.parseResult.code);
+
+		{
+			std::lock_guard<std::mutex> lock(resultMutex);
+			results.emplace(job.index, std::move(result));
+		}
+		resultReady.notify_one();
+	}
+}
+
+/* This parses the supplied tab files on a pool of worker threads, passing
+ * each result to the callback on the calling thread */
+void parseBatch(const std::vector<std::string>& paths, const BatchCallback& callback, const BatchOptions& options)
+{
+	BatchParser batch(paths, options);
+	auto result = BatchResult();
+	while (batch.next(result))
+		callback(std::move(result));
+}
+
+/* This parses the supplied in-memory tab files on a pool of worker threads,
+ * passing each result to the callback on the calling thread */
+void parseBatch(const std::vector<std::vector<char>>& buffers, const BatchCallback& callback, const BatchOptions& options)
+{
+	BatchParser batch(buffers, options);
+	auto result = BatchResult();
+	while (batch.next(result))
+		callback(std::move(result));
+}
+
+}
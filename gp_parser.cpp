@@ -1,66 +1,367 @@
 /* Copyright Phillip Potter, 2019 under MIT License
  * Based upon https://github.com/juliangruber/parse-gp5 (also MIT) */
 #include <stdexcept>
-#include <fstream>
-#include <iterator>
-#include <regex>
+#include <charconv>
 #include <algorithm>
 #include <cstdio>
 #include <cmath>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <memory>
+#include <limits>
 #include "gp_parser.h"
 
 namespace gp_parser {
 
-/* This constructor takes a Guitar Pro file and reads it into the internal
- * vector for further use */
-Parser::Parser(const char *filePath)
+// Value given to tied notes, and to strings of a tied note state, which are
+// waiting to be resolved - strings not sounded at all yet are left at -1
+static const std::int8_t UNRESOLVED_TIED_NOTE = -2;
+
+// Sizes of the fixed size records which are read after a single bounds check
+static const std::size_t CHANNEL_COUNT = 64;
+static const std::size_t CHANNEL_RECORD_SIZE = 12;
+static const std::size_t TUNING_RECORD_SIZE = 32;
+static const std::size_t COLOR_RECORD_SIZE = 4;
+static const std::size_t CHORD_RECORD_SIZE = 107;
+static const std::size_t POINT_RECORD_SIZE = 9;
+
+// Fewest bytes a measure of a track can take - a beat count for each voice,
+// followed by the byte which ends every measure
+static const std::size_t MIN_MEASURE_SIZE = 9;
+
+/* This runs 'task' for every index below 'count' across 'threadCount'
+ * threads, each of which claims the next index as soon as it finishes the
+ * last. The first exception thrown by a task is rethrown once every thread
+ * has finished */
+static void parallelFor(std::size_t count, std::size_t threadCount,
+			const std::function<void(std::size_t thread, std::size_t index)>& task)
 {
-	// Open file
+	std::atomic<std::size_t> nextIndex(0);
+	std::exception_ptr firstException;
+	std::mutex exceptionMutex;
+	auto run = [&](std::size_t thread) {
+		try {
+			for (auto i = nextIndex++; i < count; i = nextIndex++)
+				task(thread, i);
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(exceptionMutex);
+			if (!firstException)
+				firstException = std::current_exception();
+			nextIndex = count;
+		}
+	};
+
+	// The calling thread does its share of the work too
+	std::vector<std::thread> threads;
+	for (std::size_t t = 1; t < threadCount; ++t)
+		threads.emplace_back(run, t);
+	run(0);
+	for (auto& thread : threads)
+		thread.join();
+
+	if (firstException)
+		std::rethrow_exception(firstException);
+}
+
+/* This constructor takes a Guitar Pro file and loads it into the internal
+ * buffer for further use, using the backend selected in the options */
+Parser::Parser(const char *filePath, const ParseOptions& options)
+	: options(options)
+{
+	// Load file
 	if (filePath == nullptr)
 		throw std::logic_error("Null file path passed to constructor");
-	std::ifstream file;
-	file.open(filePath, std::ifstream::in | std::ifstream::binary);
+	fileBuffer = InputBuffer(filePath, options.backend);
+
+	parse();
+}
+
+/* This constructor parses a Guitar Pro file which is already in memory - the
+ * bytes are not copied, so they must outlive the parser */
+Parser::Parser(const std::byte *data, std::size_t size, const ParseOptions& options)
+	: options(options), fileBuffer(data, size)
+{
+	if (data == nullptr)
+		throw std::logic_error("Null data passed to constructor");
+
+	parse();
+}
+
+/* This constructor parses a Guitar Pro file which is already in memory, taking
+ * ownership of the supplied buffer */
+Parser::Parser(std::vector<char>&& buffer, const ParseOptions& options)
+	: options(options), fileBuffer(std::move(buffer))
+{
+	parse();
+}
+
+/* This parses another Guitar Pro file with the same parser, loading it using
+ * the backend selected in the options. The storage used for the previous tab
+ * is kept and reused, so a parser working through many files soon stops
+ * allocating */
+void Parser::parse(const char *filePath)
+{
+	if (filePath == nullptr)
+		throw std::logic_error("Null file path passed to parse");
+	reset();
+	fileBuffer.load(filePath, options.backend);
+
+	parse();
+}
+
+/* This parses another Guitar Pro file which is already in memory, as per the
+ * constructor - the bytes are not copied, so they must outlive the parser */
+void Parser::parse(const std::byte *data, std::size_t size)
+{
+	if (data == nullptr)
+		throw std::logic_error("Null data passed to parse");
+	reset();
+	fileBuffer.borrow(data, size);
+
+	parse();
+}
+
+/* This parses another Guitar Pro file which is already in memory, taking
+ * ownership of the supplied buffer */
+void Parser::parse(std::vector<char>&& buffer)
+{
+	reset();
+	fileBuffer = InputBuffer(std::move(buffer));
+
+	parse();
+}
+
+/* This parses another Guitar Pro file as per parse, but reports any failure
+ * in the result instead of throwing. Malformed files are found without any
+ * exception being raised, so this suits inputs where failures are common */
+ParseResult Parser::tryParse(const char *filePath) noexcept
+{
+	try {
+		reset();
+		if (filePath == nullptr)
+			fail(ParseErrorCode::NullInput);
+		else if (!fileBuffer.tryLoad(filePath, options.backend))
+			fail(ParseErrorCode::UnableToOpen);
+		else
+			parseAll();
+	} catch (const std::bad_alloc&) {
+		fail(ParseErrorCode::OutOfMemory);
+	} catch (...) {
+		fail(ParseErrorCode::Invalid);
+	}
+
+	return failure;
+}
+
+/* This parses another Guitar Pro file which is already in memory as per
+ * parse, but reports any failure in the result instead of throwing */
+ParseResult Parser::tryParse(const std::byte *data, std::size_t size) noexcept
+{
+	try {
+		reset();
+		if (data == nullptr) {
+			fail(ParseErrorCode::NullInput);
+		} else {
+			fileBuffer.borrow(data, size);
+			parseAll();
+		}
+	} catch (const std::bad_alloc&) {
+		fail(ParseErrorCode::OutOfMemory);
+	} catch (...) {
+		fail(ParseErrorCode::Invalid);
+	}
+
+	return failure;
+}
+
+/* This empties the parser, ready for the next tab. The vectors keep their
+ * capacity, as do the measures of each track, so any memory resource in the
+ * options must not be released while the parser is still in use */
+void Parser::reset()
+{
+	fileBuffer.clear();
+	bufferPosition = 0;
+	truncated = false;
+	phase = ParsePhase::Header;
+	phaseIndex = 0;
+	measuresPosition = 0;
+	failure = ParseResult();
+	readingNote = false;
+	auto trackNames = std::move(metadataView.trackNames);
+	trackNames.clear();
+	metadataView = TabMetadataView();
+	metadataView.trackNames = std::move(trackNames);
+
+	major = 0;
+	minor = 0;
+	title.clear();
+	subtitle.clear();
+	artist.clear();
+	album.clear();
+	lyricsAuthor.clear();
+	musicAuthor.clear();
+	copyright.clear();
+	tab.clear();
+	instructions.clear();
+	comments.clear();
+	lyric = Lyric();
+	tempoValue = 0;
+	globalKeySignature = 0;
+	channels.clear();
+	measures = 0;
+	trackCount = 0;
+	measureHeaders.clear();
+	tiedNoteStates.clear();
+	noteColumns.clear();
+
+	// Hang on to the tracks so the next tab can reuse their measure storage
+	for (auto& track : tracks) {
+		track.strings.clear();
+		track.measures.clear();
+		spareTracks.push_back(std::move(track));
+	}
+	tracks.clear();
+}
+
+/* This parses the tab file held in the file buffer, which must contain the
+ * whole file, throwing if it cannot be parsed */
+void Parser::parse()
+{
+	if (!parseAll())
+		throw std::logic_error(getName(failure.code));
+}
 
-	// Initialise vector
-	fileBuffer = std::vector<char>(
-		     std::istreambuf_iterator<char>(file),
-		     {}
-		     );
+/* This parses the tab file held in the file buffer, which must contain the
+ * whole file. False is returned if it cannot be parsed, with the reason
+ * left in 'failure' */
+bool Parser::parseAll()
+{
+	// With more than one thread the measures are read separately, so stop
+	// once everything before them has been read
+	auto lastPhase = options.threadCount > 1 ? ParsePhase::Measures : ParsePhase::Complete;
+	if (!parseAvailable(lastPhase))
+		return false;
+	if (phase == ParsePhase::Measures)
+		readMeasuresInParallel();
+
+	return phase == ParsePhase::Complete;
+}
 
-	// Close file
-	file.close();
+/* This parses as many records as the file buffer currently holds, returning
+ * true once the whole tab (or everything before 'lastPhase') has been read. A
+ * record which runs past the end of the buffer is rolled back, so that it can
+ * be read again once more data has been supplied */
+bool Parser::parseAvailable(ParsePhase lastPhase)
+{
+	while (phase != lastPhase && phase != ParsePhase::Complete) {
+		auto recordStart = bufferPosition;
+		truncated = false;
+		switch (phase) {
+		case ParsePhase::Header:
+			readHeader();
+			break;
+		case ParsePhase::Channels:
+			readChannelsAndCounts();
+			break;
+		case ParsePhase::MeasureHeaders:
+			readNextMeasureHeader();
+			break;
+		case ParsePhase::Tracks:
+			readNextTrack();
+			break;
+		case ParsePhase::Measures:
+			readNextMeasure();
+			break;
+		case ParsePhase::Complete:
+			break;
+		}
+		if (truncated) {
+			bufferPosition = recordStart;
+			return false;
+		}
+	}
+
+	return true;
+}
 
+/* This records why and where the parse failed, then marks the current record
+ * as truncated so that nothing more is read from it */
+void Parser::fail(ParseErrorCode code)
+{
+	failure.code = code;
+	failure.offset = bufferPosition;
+	switch (phase) {
+	case ParsePhase::Header:
+		failure.stage = ParseStage::Header;
+		break;
+	case ParsePhase::Channels:
+		failure.stage = ParseStage::Channels;
+		break;
+	case ParsePhase::MeasureHeaders:
+		failure.stage = ParseStage::MeasureHeaders;
+		break;
+	case ParsePhase::Tracks:
+		failure.stage = ParseStage::Tracks;
+		break;
+	case ParsePhase::Measures:
+	case ParsePhase::Complete:
+		failure.stage = readingNote ? ParseStage::Notes : ParseStage::Beats;
+		break;
+	}
+	truncated = true;
+}
+
+/* This reads the header of the tab file, up to the channel data */
+void Parser::readHeader()
+{
 	// Parse version and check it is supported
 	readVersion();
-	if (!isSupportedVersion(version))
-		throw std::logic_error("Unsupported version");
-
-	// Parse out major and minor version numbers
-	std::regex majorAndMinorExp("(\\d+)\\.(\\d+)");
-	major = std::stoi(std::regex_replace(
-			  version,
-			  majorAndMinorExp,
-			  "$1",
-			  std::regex_constants::format_no_copy));
-	minor = std::stoi(std::regex_replace(
-			  version,
-			  majorAndMinorExp,
-			  "$2",
-			  std::regex_constants::format_no_copy));
-
-	// Read attributes of tab file
-	title = readStringByteSizeOfInteger();
-	subtitle = readStringByteSizeOfInteger();
-	artist = readStringByteSizeOfInteger();
-	album = readStringByteSizeOfInteger();
-	lyricsAuthor = readStringByteSizeOfInteger();
-	musicAuthor = readStringByteSizeOfInteger();
-	copyright = readStringByteSizeOfInteger();
-	tab = readStringByteSizeOfInteger();
-	instructions = readStringByteSizeOfInteger();
+	if (truncated)
+		return;
+	if (!isSupportedVersion(version)) {
+		fail(ParseErrorCode::UnsupportedVersion);
+		return;
+	}
+	selectDecoders();
+
+	// Parse out major and minor version numbers, which follow the 'v'
+	auto number = version.substr(version.rfind('v') + 1);
+	auto dot = number.find('.');
+	std::from_chars(number.data(), number.data() + dot, major);
+	std::from_chars(number.data() + dot + 1, number.data() + number.size(), minor);
+
+	// Read attributes of tab file, noting where the descriptive ones lie
+	// in the file buffer and only copying them out if they are wanted
+	metadataView.title = readStringByteSizeOfInteger();
+	metadataView.subtitle = readStringByteSizeOfInteger();
+	metadataView.artist = readStringByteSizeOfInteger();
+	metadataView.album = readStringByteSizeOfInteger();
+	metadataView.lyricsAuthor = readStringByteSizeOfInteger();
+	metadataView.musicAuthor = readStringByteSizeOfInteger();
+	metadataView.copyright = readStringByteSizeOfInteger();
+	auto tabText = readStringByteSizeOfInteger();
+	auto instructionsText = readStringByteSizeOfInteger();
+	if (copyText) {
+		title = metadataView.title;
+		subtitle = metadataView.subtitle;
+		artist = metadataView.artist;
+		album = metadataView.album;
+		lyricsAuthor = metadataView.lyricsAuthor;
+		musicAuthor = metadataView.musicAuthor;
+		copyright = metadataView.copyright;
+		tab = tabText;
+		instructions = instructionsText;
+	}
 	auto commentLen = readInt();
-	for (auto i = 0; i < commentLen; ++i)
-		comments.push_back(readStringByteSizeOfInteger());
+	comments.clear();
+	for (auto i = 0; i < commentLen && !truncated; ++i) {
+		if (copyText)
+			comments.emplace_back(readStringByteSizeOfInteger());
+		else
+			skipStringByteSizeOfInteger();
+	}
 
 	// Read lyrics data
 	lyricTrack = readInt();
@@ -82,143 +383,397 @@ Parser::Parser(const char *filePath)
 
 	// Octave
 	readByte();
+	if (truncated)
+		return;
+
+	metadataView.tempoValue = tempoValue;
+
+	phase = ParsePhase::Channels;
+}
 
+/* This reads the channels, followed by the measure and track counts */
+void Parser::readChannelsAndCounts()
+{
 	// Read channels
-	channels = readChannels();
+	readChannels(channels);
 
 	skip(42);
 
 	// Read measures and track count info
 	measures = readInt();
 	trackCount = readInt();
+	if (truncated)
+		return;
 
-	// Read measure headers
-	auto timeSignature = TimeSignature();
-	timeSignature.numerator = 4;
-	timeSignature.denominator.value = QUARTER;
-	timeSignature.denominator.division.enters = 1;
-	timeSignature.denominator.division.times = 1;
-	for (auto i = 0; i < measures; ++i) {
-		if (i > 0)
-			skip(1);
-		std::uint8_t flags = readUnsignedByte();
-		auto header = MeasureHeader();
-		header.number = i + 1;
-		header.start = 0;
-		header.tempo.value = 120;
-		header.repeatOpen = (flags & 0x04) != 0;
-		if ((flags & 0x01) != 0)
-			timeSignature.numerator = readByte();
-		if ((flags & 0x02) != 0)
-			timeSignature.denominator.value = readByte();
-		header.timeSignature = timeSignature;
-		if ((flags & 0x08) != 0)
-			header.repeatClose = (readByte() & 0xFF) - 1;
-		if ((flags & 0x20) != 0) {
-			header.marker.measure = header.number;
-			header.marker.title = readStringByteSizeOfInteger();
-			header.marker.color = readColor();
-		}
-		if ((flags & 0x10) != 0)
-			header.repeatAlternative = readUnsignedByte();
-		if ((flags & 0x40) != 0) {
-			globalKeySignature = readKeySignature();
-			skip(1);
+	metadataView.measures = measures;
+	metadataView.trackCount = trackCount;
+
+	// Set up the time signature which carries over between measure headers
+	currentTimeSignature = TimeSignature();
+	currentTimeSignature.numerator = 4;
+	currentTimeSignature.denominator.value = QUARTER;
+	currentTimeSignature.denominator.division.enters = 1;
+	currentTimeSignature.denominator.division.times = 1;
+
+	phaseIndex = 0;
+	phase = ParsePhase::MeasureHeaders;
+}
+
+/* This reads the next measure header */
+void Parser::readNextMeasureHeader()
+{
+	if (phaseIndex >= measures) {
+		phaseIndex = 0;
+		phase = ParsePhase::Tracks;
+		return;
+	}
+
+	// Work on copies of the carried over state, so that a truncated
+	// header leaves it untouched
+	auto i = phaseIndex;
+	auto timeSignature = currentTimeSignature;
+	auto keySignature = globalKeySignature;
+
+	if (i > 0)
+		skip(1);
+	std::uint8_t flags = readUnsignedByte();
+	auto header = MeasureHeader();
+	header.number = i + 1;
+	header.start = 0;
+	header.tempo.value = 120;
+	header.repeatOpen = (flags & 0x04) != 0;
+	if ((flags & 0x01) != 0)
+		timeSignature.numerator = readByte();
+	if ((flags & 0x02) != 0)
+		timeSignature.denominator.value = readByte();
+	header.timeSignature = timeSignature;
+	if ((flags & 0x08) != 0)
+		header.repeatClose = (readByte() & 0xFF) - 1;
+	if ((flags & 0x20) != 0) {
+		header.marker.measure = header.number;
+		header.marker.title = readStringByteSizeOfInteger();
+		header.marker.color = readColor();
+	}
+	if ((flags & 0x10) != 0)
+		header.repeatAlternative = readUnsignedByte();
+	if ((flags & 0x40) != 0) {
+		keySignature = readKeySignature();
+		skip(1);
+	}
+	if ((flags & 0x01) != 0 || (flags & 0x02) != 0)
+		skip(4);
+	if ((flags & 0x10) == 0)
+		skip(1);
+	auto tripletFeel = readByte();
+	if (tripletFeel == 1)
+		header.tripletFeel = TripletFeel::Eighth;
+	else if (tripletFeel == 2)
+		header.tripletFeel = TripletFeel::Sixteenth;
+	else
+		header.tripletFeel = TripletFeel::None;
+	if (truncated)
+		return;
+
+	// Push header to vector
+	measureHeaders.push_back(header);
+	currentTimeSignature = timeSignature;
+	globalKeySignature = keySignature;
+	++phaseIndex;
+}
+
+/* This reads the next track */
+void Parser::readNextTrack()
+{
+	if (phaseIndex >= trackCount) {
+		skip(versionIndex == 0 ? 2 : 1);
+		if (truncated)
+			return;
+
+		// A header only parse stops here, before any measures are read
+		measuresPosition = bufferPosition;
+		if (options.headerOnly) {
+			phase = ParsePhase::Complete;
+			return;
 		}
-		if ((flags & 0x01) != 0 || (flags & 0x02) != 0)
-			skip(4);
-		if ((flags & 0x10) == 0)
-			skip(1);
-		auto tripletFeel = readByte();
-		if (tripletFeel == 1)
-			header.tripletFeel = "eigth";
-		else if (tripletFeel == 2)
-			header.tripletFeel = "sixteents";
-		else
-			header.tripletFeel = "none";
 
-		// Push header to vector
-		measureHeaders.push_back(header);
+		// Set up the state which carries over between measures
+		currentTempo = Tempo();
+		currentTempo.value = tempoValue;
+		currentStart = QUARTER_TIME;
+		phaseIndex = 0;
+		phase = ParsePhase::Measures;
+		return;
 	}
 
-	// Read tracks
-	for (auto number = 1; number <= trackCount; ++number) {
-		auto track = Track();
-		readUnsignedByte();
-		if (number == 1 || versionIndex == 0)
-			skip(1);
-		track.number = number;
-		track.lyrics = number == lyricTrack ? lyric : Lyric();
-		track.name = readStringByte(40);
-		auto stringCount = readInt();
-		for (auto i = 0; i < 7; ++i) {
-			auto tuning = readInt();
-			if (stringCount > i) {
-				auto string = GuitarString();
-				string.number = i + 1;
-				string.value = tuning;
-				track.strings.push_back(string);
+	// Reading the channel can add to the channel list, so note its size
+	// in case the track is truncated
+	auto number = static_cast<std::int32_t>(phaseIndex + 1);
+	auto channelCount = channels.size();
+
+	auto track = newTrack();
+	readUnsignedByte();
+	if (number == 1 || versionIndex == 0)
+		skip(1);
+	track.number = number;
+	track.lyrics = number == lyricTrack ? lyric : Lyric();
+	auto name = readStringByte(40);
+	if (copyText)
+		track.name = name;
+	auto tunings = RecordCursor();
+	auto stringCount = 0;
+	if (readRecord(TUNING_RECORD_SIZE, tunings))
+		stringCount = tunings.readInt();
+	for (auto i = 0; i < 7 && !truncated; ++i) {
+		auto tuning = tunings.readInt();
+		if (stringCount > i) {
+			auto string = GuitarString();
+			string.number = i + 1;
+			string.value = tuning;
+			track.strings.push_back(string);
+		}
+	}
+	readInt();
+	readChannel(track);
+	readInt();
+	track.offset = readInt();
+	track.color = readColor();
+	skip(versionIndex > 0 ? 49 : 44);
+	if (versionIndex > 0) {
+		skipStringByteSizeOfInteger();
+		skipStringByteSizeOfInteger();
+	}
+	if (truncated) {
+		channels.resize(channelCount);
+		return;
+	}
+
+	tracks.push_back(std::move(track));
+	tiedNoteStates.push_back(TiedNoteState());
+	metadataView.trackNames.push_back(name);
+	++phaseIndex;
+}
+
+/* This reads the next measure of the next track, moving on through the tracks
+ * of each measure in turn */
+void Parser::readNextMeasure()
+{
+	// Tabs without any tracks still have their measure headers laid out
+	if (trackCount <= 0) {
+		for (auto& header : measureHeaders) {
+			header.start = currentStart;
+			header.tempo = currentTempo;
+			if (!addLength(currentStart, header)) {
+				fail(ParseErrorCode::Invalid);
+				return;
 			}
 		}
-		readInt();
-		readChannel(track);
-		readInt();
-		track.offset = readInt();
-		track.color = readColor();
-		skip(versionIndex > 0 ? 49 : 44);
-		if (versionIndex > 0) {
-			readStringByteSizeOfInteger();
-			readStringByteSizeOfInteger();
+		phase = ParsePhase::Complete;
+		return;
+	}
+	if (phaseIndex >= static_cast<std::int64_t>(measures) * trackCount) {
+		phase = ParsePhase::Complete;
+		return;
+	}
+
+	auto i = phaseIndex / trackCount;
+	auto j = phaseIndex % trackCount;
+	auto& header = measureHeaders[i];
+	header.start = currentStart;
+	Track& track = tracks[j];
+	auto tempo = currentTempo;
+	if (isTrackSelected(j)) {
+		auto& measure = track.measures.emplace_back(memoryResource());
+		measure.header = &header;
+		measure.start = currentStart;
+		auto tiedNotes = tiedNoteStates[j];
+		(this->*measureReader)(measure, track, tempo, tiedNotes, globalKeySignature);
+		skip(1);
+		if (truncated) {
+			track.measures.pop_back();
+			return;
 		}
-		tracks.push_back(track);
+		tiedNoteStates[j] = tiedNotes;
+		if (options.buildNoteColumns)
+			addToNoteColumns(j, measure);
+		if (options.measureCallback)
+			options.measureCallback(track, measure);
+	} else {
+		(this->*measureSkipper)(track, tempo);
+		skip(1);
+		if (truncated)
+			return;
 	}
-	skip(versionIndex == 0 ? 2 : 1);
 
-	// Iterate through measures
-	auto tempo = Tempo();
-	tempo.value = tempoValue;
-	auto start = QUARTER_TIME;
+	currentTempo = tempo;
+	if (j == trackCount - 1) {
+		header.tempo = currentTempo;
+		if (!addLength(currentStart, header)) {
+			fail(ParseErrorCode::Invalid);
+			return;
+		}
+	}
+	++phaseIndex;
+}
+
+/* This reads every measure in two passes. The first walks each measure of
+ * each track without decoding it, noting where it starts and the tempo at
+ * that point. The second decodes the measures of the selected tracks across a
+ * number of threads, after which any tied notes reaching back into earlier
+ * measures are filled in, track by track */
+void Parser::readMeasuresInParallel()
+{
+	// Tabs without measures or tracks have nothing to share out
+	if (measures <= 0 || trackCount <= 0) {
+		readNextMeasure();
+		return;
+	}
+
+	// Find the start of each measure of each track, first making sure the
+	// file is big enough to hold them all, as the counts come straight from
+	// the file and the tables are sized from them
+	auto blockCount = static_cast<std::size_t>(measures) * trackCount;
+	auto remaining = bufferPosition <= fileBuffer.size() ? fileBuffer.size() - bufferPosition : 0;
+	if (blockCount > remaining / MIN_MEASURE_SIZE) {
+		fail(ParseErrorCode::Truncated);
+		return;
+	}
+	std::vector<std::size_t> blockPositions(blockCount);
+	std::vector<Tempo> blockTempos(blockCount);
 	for (auto i = 0; i < measures; ++i) {
 		auto& header = measureHeaders[i];
-		header.start = start;
+		header.start = currentStart;
 		for (auto j = 0; j < trackCount; ++j) {
-			Track& track = tracks[j];
-			auto measure = Measure();
-			measure.header = &header;
-			measure.start = start;
-			track.measures.push_back(measure);
-			readMeasure(track.measures[track.measures.size() - 1], track, tempo, globalKeySignature);
+			auto block = static_cast<std::size_t>(i) * trackCount + j;
+			blockPositions[block] = bufferPosition;
+			blockTempos[block] = currentTempo;
+			(this->*measureSkipper)(tracks[j], currentTempo);
 			skip(1);
 		}
-		header.tempo = tempo;
-		start += getLength(header);
+		if (truncated)
+			return;
+		header.tempo = currentTempo;
+		if (!addLength(currentStart, header)) {
+			fail(ParseErrorCode::Invalid);
+			return;
+		}
+	}
+	auto measuresEnd = bufferPosition;
+
+	// Lay out the measures of the selected tracks, so that each thread can
+	// decode straight into its own measure
+	std::vector<std::size_t> selectedBlocks;
+	for (auto j = 0; j < trackCount; ++j) {
+		if (!isTrackSelected(j))
+			continue;
+		auto& track = tracks[j];
+		track.measures.reserve(measures);
+		for (auto i = 0; i < measures; ++i) {
+			auto& measure = track.measures.emplace_back(memoryResource());
+			measure.header = &measureHeaders[i];
+			measure.start = measureHeaders[i].start;
+			selectedBlocks.push_back(static_cast<std::size_t>(i) * trackCount + j);
+		}
+	}
+
+	// Set up a parser for each thread, sharing the file buffer
+	auto threadCount = std::min(options.threadCount, selectedBlocks.size());
+	std::vector<std::unique_ptr<Parser>> workers;
+	for (std::size_t t = 0; t < threadCount; ++t) {
+		auto worker = std::unique_ptr<Parser>(new Parser(options));
+		worker->fileBuffer = InputBuffer(reinterpret_cast<const std::byte *>(fileBuffer.data()), fileBuffer.size());
+		worker->phase = ParsePhase::Measures;
+		worker->versionIndex = versionIndex;
+		worker->selectDecoders();
+		worker->channels = channels;
+		workers.push_back(std::move(worker));
+	}
+
+	// Decode the measures, each starting with none of its strings known so
+	// that tied notes reaching back into earlier measures are left unresolved.
+	// Each must end where the pre-scan found the next one to start, less the
+	// byte which follows every measure
+	std::vector<TiedNoteState> blockTiedNotes(selectedBlocks.size());
+	parallelFor(selectedBlocks.size(), threadCount,
+		[&](std::size_t thread, std::size_t index) {
+			auto block = selectedBlocks[index];
+			auto& worker = *workers[thread];
+			auto& track = tracks[block % trackCount];
+			auto tempo = blockTempos[block];
+			auto& tiedNotes = blockTiedNotes[index];
+			std::fill(std::begin(tiedNotes.frets), std::end(tiedNotes.frets), UNRESOLVED_TIED_NOTE);
+			worker.bufferPosition = blockPositions[block];
+			(worker.*measureReader)(track.measures[block / trackCount], track, tempo, tiedNotes, globalKeySignature);
+			auto end = block + 1 < blockCount ? blockPositions[block + 1] : measuresEnd;
+			if (!worker.truncated && worker.bufferPosition + 1 != end)
+				worker.fail(ParseErrorCode::Invalid);
+		});
+
+	// A worker which could not decode one of its measures fails the parse,
+	// as reading the measures in turn would have, at the earliest failure
+	for (auto& worker : workers) {
+		if (worker->truncated && (!truncated || worker->failure.offset < failure.offset)) {
+			failure = worker->failure;
+			truncated = true;
+		}
 	}
+	if (truncated)
+		return;
+
+	// Resolve tied notes in order, carrying state from measure to measure -
+	// the blocks of each track were laid out one after the other
+	std::size_t index = 0;
+	for (auto j = 0; j < trackCount; ++j) {
+		if (!isTrackSelected(j))
+			continue;
+		auto& state = tiedNoteStates[j];
+		for (auto& measure : tracks[j].measures)
+			resolveTiedNotes(measure, state, blockTiedNotes[index++]);
+	}
+
+	// Only now are the measures complete, so add them to the note columns
+	// and report them, in file order
+	if (options.buildNoteColumns || options.measureCallback) {
+		for (auto i = 0; i < measures; ++i) {
+			for (auto j = 0; j < trackCount; ++j) {
+				if (!isTrackSelected(j))
+					continue;
+				if (options.buildNoteColumns)
+					addToNoteColumns(j, tracks[j].measures[i]);
+				if (options.measureCallback)
+					options.measureCallback(tracks[j], tracks[j].measures[i]);
+			}
+		}
+	}
+
+	phaseIndex = blockCount;
+	phase = ParsePhase::Complete;
 }
 
 /* This reads an unsigned byte from the file buffer and increments the
  * position at the same time */
 std::uint8_t Parser::readUnsignedByte()
 {
-	return static_cast<uint8_t>(fileBuffer[bufferPosition++]);
+	if (!canRead(1))
+		return 0;
+	return static_cast<uint8_t>(fileBuffer.data()[bufferPosition++]);
 }
 
 /* This reads a signed byte from the file buffer and increments the
  * position at the same time */
 std::int8_t Parser::readByte()
 {
-	return static_cast<int8_t>(fileBuffer[bufferPosition++]);
+	if (!canRead(1))
+		return 0;
+	return static_cast<int8_t>(fileBuffer.data()[bufferPosition++]);
 }
 
 /* This reads a signed 32-bit integer from the file buffer in little-endian
  * mode and increments the position at the same time */
 std::int32_t Parser::readInt()
 {
-	auto returnVal = static_cast<int32_t>(
-			    ((fileBuffer[bufferPosition + 3] & 0xFF) << 24) |
-			    ((fileBuffer[bufferPosition + 2] & 0xFF) << 16) |
-			    ((fileBuffer[bufferPosition + 1] & 0xFF) << 8) |
-			    (fileBuffer[bufferPosition] & 0xFF)
-			    );
+	if (!canRead(4))
+		return 0;
+	auto returnVal = RecordCursor::loadInt(fileBuffer.data() + bufferPosition);
 	bufferPosition += 4;
 
 	return returnVal;
@@ -226,37 +781,34 @@ std::int32_t Parser::readInt()
 
 /* This version of the function takes no 'len' parameter and merely forwards
  * through to the full method by setting 'len' to be equal to 'size' */
-std::string Parser::readString(size_t size)
+std::string_view Parser::readString(size_t size)
 {
 	return readString(size, size);
 }
 
 /* This returns a string from the file buffer, in the general case by reading
- * 'size' bytes from the file buffer then converting it to a string of 'len'
- * bytes */
-std::string Parser::readString(size_t size, size_t len)
+ * 'size' bytes from the file buffer and keeping the first 'len' of them. The
+ * string is a view straight into the file buffer, so nothing is copied until
+ * the caller keeps it */
+std::string_view Parser::readString(size_t size, size_t len)
 {
 	// Work out number of bytes to read
 	auto bytesToRead = size > 0 ? size : len;
+	if (!canRead(bytesToRead))
+		return std::string_view();
 
-	// Read this number of bytes from the file buffer
-	auto bytes = std::vector<char>(bytesToRead);
-	std::copy(fileBuffer.begin() + bufferPosition,
-		  fileBuffer.begin() + bufferPosition + bytesToRead,
-		  bytes.begin());
+	auto string = std::string_view(fileBuffer.data() + bufferPosition,
+				       len <= bytesToRead ? len : bytesToRead);
 
 	// Increment position
 	bufferPosition += bytesToRead;
 
-	// Convert to string and return
-	return std::string(bytes.begin(),
-			   len >= 0 && len <= bytesToRead ?
-			   (bytes.begin() + len) : (bytes.begin() + size));
+	return string;
 }
 
 /* This returns a string from the file buffer, but using a byte before it to
  * tell it the length of the string */
-std::string Parser::readStringByte(size_t size)
+std::string_view Parser::readStringByte(size_t size)
 {
 	return readString(size, readUnsignedByte());
 }
@@ -264,20 +816,90 @@ std::string Parser::readStringByte(size_t size)
 /* This returns a string from the file buffer, but using an integer before it
  * to tell it the total number of bytes to read - the initial byte that is
  * read still gives the string length */
-std::string Parser::readStringByteSizeOfInteger()
+std::string_view Parser::readStringByteSizeOfInteger()
 {
-	return readStringByte(readInt() - 1);
+	return readStringByte(static_cast<std::size_t>(readInt()) - 1);
 }
 
-std::string Parser::readStringInteger()
+std::string_view Parser::readStringInteger()
 {
 	return readString(readInt());
 }
 
+/* This skips past a string laid out as per readStringByte */
+void Parser::skipStringByte(std::size_t size)
+{
+	auto len = readUnsignedByte();
+	skip(size > 0 ? size : len);
+}
+
+/* This skips past a string laid out as per readStringInteger */
+void Parser::skipStringInteger()
+{
+	skip(readInt());
+}
+
+/* This skips past a string laid out as per readStringByteSizeOfInteger,
+ * without copying it */
+void Parser::skipStringByteSizeOfInteger()
+{
+	auto size = static_cast<std::size_t>(readInt()) - 1;
+	auto len = readUnsignedByte();
+	skip(size > 0 ? size : len);
+}
+
 /* This just moves the position past 'n' number of bytes in the file buffer */
 void Parser::skip(std::size_t n)
 {
-	bufferPosition += n;
+	if (canRead(n))
+		bufferPosition += n;
+}
+
+/* This checks that 'n' more bytes are available in the file buffer, marking
+ * the current record as truncated if they are not - once a record has been
+ * truncated every further read fails, so no counts are read out of place */
+bool Parser::canRead(std::size_t n)
+{
+	if (!truncated && bufferPosition <= fileBuffer.size() && n <= fileBuffer.size() - bufferPosition)
+		return true;
+	if (!truncated)
+		fail(ParseErrorCode::Truncated);
+
+	return false;
+}
+
+/* This checks that 'count' records of 'size' bytes each are available in the
+ * file buffer, as per canRead. The count comes straight from the file, so it
+ * is checked against the bytes left before anything is multiplied, and a
+ * negative count fails the parse as invalid */
+bool Parser::canReadRecords(std::int32_t count, std::size_t size)
+{
+	if (count < 0) {
+		if (!truncated)
+			fail(ParseErrorCode::Invalid);
+		return false;
+	}
+	auto remaining = bufferPosition <= fileBuffer.size() ? fileBuffer.size() - bufferPosition : 0;
+	if (static_cast<std::size_t>(count) > remaining / size) {
+		if (!truncated)
+			fail(ParseErrorCode::Truncated);
+		return false;
+	}
+
+	return canRead(static_cast<std::size_t>(count) * size);
+}
+
+/* This checks that a whole fixed size record is available in the file buffer,
+ * returning false if not, and otherwise moves past it - its fields are then
+ * read through the cursor without any further checks */
+bool Parser::readRecord(std::size_t size, RecordCursor& record)
+{
+	if (!canRead(size))
+		return false;
+	record = RecordCursor(fileBuffer.data() + bufferPosition);
+	bufferPosition += size;
+
+	return true;
 }
 
 /* This reads the version data from the file buffer */
@@ -287,7 +909,7 @@ void Parser::readVersion()
 }
 
 /* This checks if the supplied version is supported by the parser */
-bool Parser::isSupportedVersion(std::string& version)
+bool Parser::isSupportedVersion(std::string_view version)
 {
 	auto versionsCount = sizeof(VERSIONS) / sizeof(const char *);
 	for (auto i = 0; i < versionsCount; ++i) {
@@ -299,6 +921,22 @@ bool Parser::isSupportedVersion(std::string& version)
 	return false;
 }
 
+/* This chooses the measure decoders for the version being read - each version
+ * listed in VERSIONS needs its own case here */
+void Parser::selectDecoders()
+{
+	switch (versionIndex) {
+	case 0:
+		measureReader = &Parser::readMeasure<0>;
+		measureSkipper = &Parser::skipMeasure<0>;
+		break;
+	case 1:
+		measureReader = &Parser::readMeasure<1>;
+		measureSkipper = &Parser::skipMeasure<1>;
+		break;
+	}
+}
+
 /* This reads lyrics data */
 Lyric Parser::readLyrics()
 {
@@ -308,7 +946,7 @@ Lyric Parser::readLyrics()
 
 	for (auto i = 0; i < 4; ++i) {
 		readInt();
-		readStringInteger();
+		skipStringInteger();
 	}
 
 	return lyric;
@@ -320,7 +958,7 @@ void Parser::readPageSetup()
 	skip(versionIndex > 0 ? 49 : 30);
 	for (auto i = 0; i < 11; ++i) {
 		skip(4);
-		readStringByte(0);
+		skipStringByte(0);
 	}
 }
 
@@ -334,42 +972,45 @@ std::int8_t Parser::readKeySignature()
 	return keySignature;
 }
 
-/* This reads the channel attributes data */
-std::vector<Channel> Parser::readChannels()
+/* This reads the channel attributes data into the supplied vector */
+void Parser::readChannels(std::vector<Channel>& channels)
 {
-	std::vector<Channel> channels;
-	for (auto i = 0; i < 64; ++i) {
+	channels.clear();
+	auto record = RecordCursor();
+	if (!readRecord(CHANNEL_COUNT * CHANNEL_RECORD_SIZE, record))
+		return;
+	for (std::size_t i = 0; i < CHANNEL_COUNT; ++i) {
 		auto channel = Channel();
-		channel.program = readInt();
-		channel.volume = readByte();
-		channel.balance = readByte();
-		channel.chorus = readByte();
-		channel.reverb = readByte();
-		channel.phaser = readByte();
-		channel.tremolo = readByte();
+		channel.program = record.readInt();
+		channel.volume = record.readByte();
+		channel.balance = record.readByte();
+		channel.chorus = record.readByte();
+		channel.reverb = record.readByte();
+		channel.phaser = record.readByte();
+		channel.tremolo = record.readByte();
 		if (i == 9) {
-			channel.bank = "default percussion bank";
+			channel.bank = ChannelBank::DefaultPercussion;
 			channel.isPercussionChannel = true;
 		} else {
-			channel.bank = "default bank";
+			channel.bank = ChannelBank::Default;
 		}
 		if (channel.program < 0)
 			channel.program = 0;
 		channels.push_back(channel);
-		skip(2);
+		record.skip(2);
 	}
-
-	return channels;
 }
 
 /* Read a color value */
 Color Parser::readColor()
 {
 	auto c = Color();
-	c.r = readUnsignedByte();
-	c.g = readUnsignedByte();
-	c.b = readUnsignedByte();
-	skip(1);
+	auto record = RecordCursor();
+	if (!readRecord(COLOR_RECORD_SIZE, record))
+		return c;
+	c.r = record.readUnsignedByte();
+	c.g = record.readUnsignedByte();
+	c.b = record.readUnsignedByte();
 
 	return c;
 }
@@ -377,18 +1018,25 @@ Color Parser::readColor()
 /* Read a channel */
 void Parser::readChannel(Track& track)
 {
-	auto gmChannel1 = readInt() - 1;
-	auto gmChannel2 = readInt() - 1;
-	if (gmChannel1 >= 0 && gmChannel1 < channels.size()) {
-		// Allocate temporary buffer to hold chars for conversion
+	// The channel numbers come straight from the file, so the smallest one
+	// is left as it is rather than overflowing when one is taken off
+	auto gmChannel1 = readInt();
+	auto gmChannel2 = readInt();
+	if (gmChannel1 > std::numeric_limits<std::int32_t>::min())
+		--gmChannel1;
+	if (gmChannel2 > std::numeric_limits<std::int32_t>::min())
+		--gmChannel2;
+	if (gmChannel1 >= 0 && static_cast<std::size_t>(gmChannel1) < channels.size()) {
+		// Only as many characters are kept as the number has digits
 		auto gmChannel1Param = ChannelParam();
 		auto gmChannel2Param = ChannelParam();
+		auto gmChannel2Value = gmChannel1 != 9 ? gmChannel2 : gmChannel1;
 		gmChannel1Param.key = "gm channel 1";
+		gmChannel1Param.value = std::to_string(gmChannel1);
 		gmChannel1Param.value.resize(numOfDigits(gmChannel1));
-		std::sprintf(&gmChannel1Param.value[0], "%d", gmChannel1);
 		gmChannel2Param.key = "gm channel 2";
-		gmChannel2Param.value.resize(numOfDigits(gmChannel1 != 9 ? gmChannel2 : gmChannel1));
-		std::sprintf(&gmChannel2Param.value[0], "%d", gmChannel1 != 9 ? gmChannel2 : gmChannel1);
+		gmChannel2Param.value = std::to_string(gmChannel2Value);
+		gmChannel2Param.value.resize(numOfDigits(gmChannel2Value));
 
 		// Copy channel to temporary variable
 		Channel channel = channels[gmChannel1];
@@ -413,62 +1061,98 @@ void Parser::readChannel(Track& track)
 }
 
 /* Read a measure */
-void Parser::readMeasure(Measure& measure, Track& track, Tempo& tempo, std::int8_t keySignature)
+template <std::size_t Version>
+void Parser::readMeasure(Measure& measure, Track& track, Tempo& tempo, TiedNoteState& tiedNotes, std::int8_t keySignature)
 {
+	auto cursor = BeatCursor();
 	for (auto voice = 0; voice < 2; ++voice) {
 		auto start = measure.start;
 		auto beats = readInt();
-		for (auto k = 0; k < beats; ++k)
-			start += readBeat(start, measure, track, tempo, voice);
-	}
-
-	std::vector<Beat*> emptyBeats;
-	for (auto i = 0; i < measure.beats.size(); ++i) {
-		auto beatPtr = &measure.beats[i];
-		auto empty = true;
-		for (auto v = 0; v < beatPtr->voices.size(); ++v) {
-			if (beatPtr->voices[v].notes.size() != 0)
-				empty = false;
-		}
-		if (empty)
-			emptyBeats.push_back(beatPtr);
-	}
-	for (auto beatPtr : emptyBeats) {
-		for (auto i = 0; i < measure.beats.size(); ++i) {
-			if (beatPtr == &measure.beats[i]) {
-				measure.beats.erase(measure.beats.begin() + i);
-				break;
+		for (auto k = 0; k < beats && !truncated; ++k) {
+			auto beatPosition = bufferPosition;
+			auto duration = readBeat<Version>(start, measure, track, tempo, tiedNotes, voice, cursor);
+			if (!truncated && !addTime(start, duration)) {
+				bufferPosition = beatPosition;
+				fail(ParseErrorCode::Invalid);
 			}
 		}
+		cursor.shared = measure.beats.size();
 	}
+
+	// Drop beats without notes in a single stable pass - they can't be
+	// skipped while reading, as the other voice may still add notes to them
+	auto isEmpty = [](const Beat& beat) {
+		for (auto& voice : beat.voices) {
+			if (voice.notes.size() != 0)
+				return false;
+		}
+		return true;
+	};
+	measure.beats.erase(std::remove_if(measure.beats.begin(), measure.beats.end(), isEmpty),
+			    measure.beats.end());
 	measure.clef = getClef(track);
 	measure.keySignature = keySignature;
 }
 
-/* Get measure length */
-std::int32_t Parser::getLength(MeasureHeader& header)
+/* This returns the rare effects of a note within the measure, which are all
+ * left at their defaults for notes without any */
+const RareNoteEffects& Measure::getRareNoteEffects(const NoteEffect& effect) const
+{
+	static const RareNoteEffects defaultEffects = RareNoteEffects();
+	if (effect.rareEffects < 0 || static_cast<std::size_t>(effect.rareEffects) >= rareNoteEffects.size())
+		return defaultEffects;
+
+	return rareNoteEffects[effect.rareEffects];
+}
+
+/* This adds the length of a measure to the start before it, returning false
+ * if the result would not fit in a start */
+bool Parser::addLength(std::int32_t& start, MeasureHeader& header)
 {
-	return static_cast<std::int32_t>(std::round(header.timeSignature.numerator *
+	return addTime(start, std::round(header.timeSignature.numerator *
 		getTime(denominatorToDuration(header.timeSignature.denominator))));
 }
 
-/* Adds a new measure to the beat */
-Beat& Parser::getBeat(Measure& measure, std::int32_t start)
+/* This adds a time to a start, dropping any fraction, returning false if the
+ * result would not fit in a start. Times are worked out from durations which
+ * come straight from the file, so they can be anything, including infinite
+ * or not a number at all */
+bool Parser::addTime(std::int32_t& start, double time)
 {
-	for (auto& beat : measure.beats) {
-		if (beat.start == start)
-			return beat;
-	}
+	auto next = start + time;
+	if (!(next > std::numeric_limits<std::int32_t>::min() - 1.0 &&
+	      next < std::numeric_limits<std::int32_t>::max() + 1.0))
+		return false;
+	start = static_cast<std::int32_t>(next);
 
-	auto beat = Beat();
-	beat.voices.resize(2);
+	return true;
+}
+
+/* Gets the beat at the supplied start, adding a new one to the measure if
+ * there isn't one yet. The starts within each voice never go backwards, so
+ * the beat is either the one last added or one of the first voice's beats
+ * at or after the cursor, keeping the lookup linear across the measure */
+Beat& Parser::getBeat(Measure& measure, std::int32_t start, BeatCursor& cursor)
+{
+	auto& beats = measure.beats;
+	while (cursor.next < cursor.shared && beats[cursor.next].start < start)
+		++cursor.next;
+	if (cursor.next < cursor.shared && beats[cursor.next].start == start)
+		return beats[cursor.next];
+	if (beats.size() > cursor.shared && beats.back().start == start)
+		return beats.back();
+
+	auto& beat = beats.emplace_back(memoryResource());
+	beat.voices.reserve(2);
+	beat.voices.emplace_back(memoryResource());
+	beat.voices.emplace_back(memoryResource());
 	beat.start = start;
-	measure.beats.push_back(beat);
 
-	return measure.beats[measure.beats.size() - 1];
+	return beat;
 }
 
 /* Read mix change */
+template <std::size_t Version>
 void Parser::readMixChange(Tempo& tempo)
 {
 	readByte(); // instrument
@@ -480,7 +1164,7 @@ void Parser::readMixChange(Tempo& tempo)
 	auto reverb = readByte();
 	auto phaser = readByte();
 	auto tremolo = readByte();
-	readStringByteSizeOfInteger(); // tempoName
+	skipStringByteSizeOfInteger(); // tempoName
 	auto tempoValue = readInt();
 	if (volume >= 0)
 		readByte();
@@ -497,42 +1181,47 @@ void Parser::readMixChange(Tempo& tempo)
 	if (tempoValue >= 0) {
 		tempo.value = tempoValue;
 		skip(1);
-		if (versionIndex > 0)
+		if constexpr (Version > 0)
 			skip(1);
 	}
 	readByte();
 	skip(1);
-	if (versionIndex > 0) {
-		readStringByteSizeOfInteger();
-		readStringByteSizeOfInteger();
+	if constexpr (Version > 0) {
+		skipStringByteSizeOfInteger();
+		skipStringByteSizeOfInteger();
 	}
 }
 
 /* Read beat effects */
-void Parser::readBeatEffects(Beat& beat, NoteEffect& noteEffect)
+void Parser::readBeatEffects(Beat& beat, Measure& measure, NoteEffect& noteEffect)
 {
 	auto flags1 = readUnsignedByte();
 	auto flags2 = readUnsignedByte();
-	noteEffect.fadeIn = (flags1 & 0x10) != 0;
-	noteEffect.vibrato = (flags1 & 0x02) != 0;
+	noteEffect.setFlag(NOTE_EFFECT_FADE_IN, (flags1 & 0x10) != 0);
+	noteEffect.setFlag(NOTE_EFFECT_VIBRATO, (flags1 & 0x02) != 0);
 	if ((flags1 & 0x20) != 0) {
 		auto effect = readUnsignedByte();
-		noteEffect.tapping = effect == 1;
-		noteEffect.slapping = effect == 2;
-		noteEffect.popping = effect == 3;
+		noteEffect.setFlag(NOTE_EFFECT_TAPPING, effect == 1);
+		noteEffect.setFlag(NOTE_EFFECT_SLAPPING, effect == 2);
+		noteEffect.setFlag(NOTE_EFFECT_POPPING, effect == 3);
+	}
+	if ((flags2 & 0x04) != 0) {
+		// The tremolo bar is shared by every note of the beat
+		auto effects = RareNoteEffects(memoryResource());
+		readTremoloBar(effects);
+		noteEffect.rareEffects = measure.rareNoteEffects.size();
+		measure.rareNoteEffects.push_back(std::move(effects));
 	}
-	if ((flags2 & 0x04) != 0)
-		readTremoloBar(noteEffect);
 	if ((flags1 & 0x40) != 0) {
 		auto strokeUp = readByte();
 		auto strokeDown = readByte();
 		// TODO
 		if (strokeUp > 0) {
-			beat.stroke.direction = "stroke_up";
-			beat.stroke.value = "stroke_down";
+			beat.stroke.direction = StrokeDirection::StrokeUp;
+			beat.stroke.value = StrokeDirection::StrokeDown;
 		} else if (strokeDown > 0) {
-			beat.stroke.direction = "stroke_down";
-			beat.stroke.value = "stroke_down";
+			beat.stroke.direction = StrokeDirection::StrokeDown;
+			beat.stroke.value = StrokeDirection::StrokeDown;
 		}
 	}
 	if ((flags2 & 0x02) != 0)
@@ -540,11 +1229,16 @@ void Parser::readBeatEffects(Beat& beat, NoteEffect& noteEffect)
 }
 
 /* Read tremolo bar */
-void Parser::readTremoloBar(NoteEffect& effect)
+void Parser::readTremoloBar(RareNoteEffects& effects)
 {
 	skip(5);
-	auto tremoloBar = TremoloBar();
+	auto tremoloBar = TremoloBar(memoryResource());
 	auto numPoints = readInt();
+
+	// The count comes straight from the file, so make sure the points are
+	// all there before reading them
+	if (!canReadRecords(numPoints, POINT_RECORD_SIZE))
+		return;
 	for (auto i = 0; i < numPoints; ++i) {
 		auto position = readInt();
 		auto value = readInt();
@@ -559,8 +1253,10 @@ void Parser::readTremoloBar(NoteEffect& effect)
 				* 0x2f))); //TODO
 		tremoloBar.points.push_back(point);
 	}
-	if (tremoloBar.points.size() > 0)
-		effect.tremoloBar = tremoloBar;
+	if (tremoloBar.points.size() > 0) {
+		effects.tremoloBar = std::move(tremoloBar);
+		effects.flags |= RARE_NOTE_EFFECT_TREMOLO_BAR;
+	}
 }
 
 /* Read beat text */
@@ -572,21 +1268,25 @@ void Parser::readText(Beat& beat)
 /* Read chord */
 void Parser::readChord(std::vector<GuitarString>& strings, Beat& beat)
 {
-	auto chord = Chord();
+	auto record = RecordCursor();
+	if (!readRecord(CHORD_RECORD_SIZE, record))
+		return;
+
+	auto chord = Chord(memoryResource());
 	chord.strings = &strings;
-	skip(17);
-	chord.name = readStringByte(21);
-	skip(4);
+	record.skip(17);
+	std::size_t nameLength = record.readUnsignedByte();
+	chord.name.assign(record.data(), std::min<std::size_t>(nameLength, 21));
+	record.skip(21 + 4);
 	chord.frets.resize(6);
-	chord.frets[0] = readInt();
-	for (auto i = 0; i < 7; ++i) {
-		auto fret = readInt();
-		if (i < chord.strings->size())
+	chord.frets[0] = record.readInt();
+	for (std::size_t i = 0; i < 7; ++i) {
+		auto fret = record.readInt();
+		if (i < chord.strings->size() && i < chord.frets.size())
 			chord.frets[i] = fret;
 	}
-	skip(32);
 	if (chord.strings->size() > 0)
-		beat.chord = chord;
+		beat.chord = std::move(chord);
 }
 
 /* Get duration */
@@ -657,11 +1357,13 @@ double Parser::readDuration(std::uint8_t flags)
 }
 
 /* Read beat */
-double Parser::readBeat(std::int32_t start, Measure& measure, Track& track, Tempo& tempo, std::size_t voiceIndex)
+template <std::size_t Version>
+double Parser::readBeat(std::int32_t start, Measure& measure, Track& track, Tempo& tempo,
+			TiedNoteState& tiedNotes, std::size_t voiceIndex, BeatCursor& cursor)
 {
 	auto flags = readUnsignedByte();
 
-	auto& beat = getBeat(measure, start);
+	auto& beat = getBeat(measure, start, cursor);
 	auto& voice = beat.voices[voiceIndex];
 	if ((flags & 0x40) != 0) {
 		auto beatType = readUnsignedByte();
@@ -674,14 +1376,16 @@ double Parser::readBeat(std::int32_t start, Measure& measure, Track& track, Temp
 	if ((flags & 0x04) != 0)
 		readText(beat);
 	if ((flags & 0x08) != 0)
-		readBeatEffects(beat, effect);
+		readBeatEffects(beat, measure, effect);
 	if ((flags & 0x10) != 0)
-		readMixChange(tempo);
+		readMixChange<Version>(tempo);
 	auto stringFlags = readUnsignedByte();
 	for (auto i = 6; i >= 0; --i) {
 		if ((stringFlags & (1 << i)) != 0 && (6 - i) < track.strings.size()) {
 			auto string = track.strings[6 - i];
-			auto note = readNote(string, track, effect);
+			auto note = readNote(string, measure, tiedNotes, effect);
+			if (!voice.empty && note.string >= 1 && note.string <= 7)
+				tiedNotes.frets[note.string - 1] = note.value;
 			voice.notes.push_back(note);
 		}
 		voice.duration = duration;
@@ -697,19 +1401,20 @@ double Parser::readBeat(std::int32_t start, Measure& measure, Track& track, Temp
 }
 
 /* Read note */
-Note Parser::readNote(GuitarString& string, Track& track, NoteEffect& effect)
+Note Parser::readNote(GuitarString& string, Measure& measure, const TiedNoteState& tiedNotes, NoteEffect& effect)
 {
+	readingNote = true;
 	auto flags = readUnsignedByte();
 	auto note = Note();
 	note.string = string.number;
 	note.effect = effect;
-	note.effect.accentuatedNote = (flags & 0x40) != 0;
-	note.effect.heavyAccentuatedNote = (flags & 0x02) != 0;
-	note.effect.ghostNote = (flags & 0x04) != 0;
+	note.effect.setFlag(NOTE_EFFECT_ACCENTUATED_NOTE, (flags & 0x40) != 0);
+	note.effect.setFlag(NOTE_EFFECT_HEAVY_ACCENTUATED_NOTE, (flags & 0x02) != 0);
+	note.effect.setFlag(NOTE_EFFECT_GHOST_NOTE, (flags & 0x04) != 0);
 	if ((flags & 0x20) != 0) {
 		auto noteType = readUnsignedByte();
 		note.tiedNote = noteType == 0x02;
-		note.effect.deadNote = noteType == 0x03;
+		note.effect.setFlag(NOTE_EFFECT_DEAD_NOTE, noteType == 0x03);
 	}
 	if ((flags & 0x10) != 0) {
 		note.velocity = TGVELOCITIES_MIN_VELOCITY +
@@ -719,11 +1424,13 @@ Note Parser::readNote(GuitarString& string, Track& track, NoteEffect& effect)
 	if ((flags & 0x20) != 0) {
 		auto fret = readByte();
 		auto value = note.tiedNote
-			? getTiedNoteValue(string.number, track)
+			? getTiedNoteValue(string.number, tiedNotes)
 			: fret;
 		note.value = value >= 0 && value < 100
 			? value
 			: 0;
+		if (note.tiedNote && value == UNRESOLVED_TIED_NOTE)
+			note.value = UNRESOLVED_TIED_NOTE;
 	}
 	if ((flags & 0x80) != 0)
 		skip(2);
@@ -731,88 +1438,111 @@ Note Parser::readNote(GuitarString& string, Track& track, NoteEffect& effect)
 		skip(8);
 	skip(1);
 	if ((flags & 0x08) != 0)
-		readNoteEffects(note.effect);
+		readNoteEffects(measure, note.effect);
+	readingNote = false;
 
 	return note;
 }
 
-/* Get tied note value */
-std::int8_t Parser::getTiedNoteValue(std::int32_t string, Track& track)
-{
-	auto measureCount = track.measures.size();
-	if (measureCount > 0) {
-		for (auto m = measureCount - 1; m >= 0; --m) {
-			auto& measure = track.measures[m];
-			for (auto b = static_cast<std::int64_t>(measure.beats.size()) - 1; b >= 0; --b) {
-				auto& beat = measure.beats[b];
-				for (auto v = 0; v < beat.voices.size(); ++v) {
-					auto& voice = beat.voices[v];
-					if (!voice.empty) {
-						for (auto n = 0; n < voice.notes.size(); ++n) {
-							auto& note = voice.notes[n];
-							if (note.string == string)
-								return note.value;
-						}
-					}
+/* Get tied note value, which is the last value sounded on the string */
+std::int8_t Parser::getTiedNoteValue(std::int32_t string, const TiedNoteState& tiedNotes)
+{
+	return string >= 1 && string <= 7
+		? tiedNotes.frets[string - 1]
+		: -1;
+}
+
+/* Fill in the tied notes of a measure which were left unresolved by a
+ * parallel decode, using the state carried over from the measures before it,
+ * then update that state with the strings sounded within the measure */
+void Parser::resolveTiedNotes(Measure& measure, TiedNoteState& tiedNotes, const TiedNoteState& measureTiedNotes)
+{
+	for (auto& beat : measure.beats) {
+		for (auto& voice : beat.voices) {
+			for (auto& note : voice.notes) {
+				if (note.tiedNote && note.value == UNRESOLVED_TIED_NOTE) {
+					auto value = getTiedNoteValue(note.string, tiedNotes);
+					note.value = value >= 0 && value < 100 ? value : 0;
 				}
 			}
 		}
 	}
 
-	return 0;
+	for (auto i = 0; i < 7; ++i) {
+		if (measureTiedNotes.frets[i] != UNRESOLVED_TIED_NOTE)
+			tiedNotes.frets[i] = measureTiedNotes.frets[i];
+	}
 }
 
 /* Read effects for note */
-void Parser::readNoteEffects(NoteEffect& noteEffect)
+void Parser::readNoteEffects(Measure& measure, NoteEffect& noteEffect)
 {
 	auto flags1 = readUnsignedByte();
 	auto flags2 = readUnsignedByte();
+
+	// Notes with any of the rare effects get their own entry in the measure,
+	// starting from whatever their beat gave them
+	auto hasRareEffects = (flags1 & 0x11) != 0 || (flags2 & 0x34) != 0;
+	auto effects = RareNoteEffects(memoryResource());
+	if (hasRareEffects && noteEffect.rareEffects != NO_RARE_NOTE_EFFECTS)
+		effects = measure.rareNoteEffects[noteEffect.rareEffects];
 	if ((flags1 & 0x01) != 0)
-		readBend(noteEffect);
+		readBend(effects);
 	if ((flags1 & 0x10) != 0)
-		readGrace(noteEffect);
+		readGrace(effects);
 	if ((flags2 & 0x04) != 0)
-		readTremoloPicking(noteEffect);
+		readTremoloPicking(effects);
 	if ((flags2 & 0x08) != 0) {
-		noteEffect.slide = true;
+		noteEffect.setFlag(NOTE_EFFECT_SLIDE, true);
 		readByte();
 	}
 	if ((flags2 & 0x10) != 0)
-		readArtificialHarmonic(noteEffect);
+		readArtificialHarmonic(effects);
 	if ((flags2 & 0x20) != 0)
-		readTrill(noteEffect);
-	noteEffect.hammer = (flags1 & 0x02) != 0;
-	noteEffect.letRing = (flags1 & 0x08) != 0;
-	noteEffect.vibrato = (flags2 & 0x40) != 0;
-	noteEffect.palmMute = (flags2 & 0x02) != 0;
-	noteEffect.staccato = (flags2 & 0x01) != 0;
+		readTrill(effects);
+	if (hasRareEffects) {
+		noteEffect.rareEffects = measure.rareNoteEffects.size();
+		measure.rareNoteEffects.push_back(std::move(effects));
+	}
+	noteEffect.setFlag(NOTE_EFFECT_HAMMER, (flags1 & 0x02) != 0);
+	noteEffect.setFlag(NOTE_EFFECT_LET_RING, (flags1 & 0x08) != 0);
+	noteEffect.setFlag(NOTE_EFFECT_VIBRATO, (flags2 & 0x40) != 0);
+	noteEffect.setFlag(NOTE_EFFECT_PALM_MUTE, (flags2 & 0x02) != 0);
+	noteEffect.setFlag(NOTE_EFFECT_STACCATO, (flags2 & 0x01) != 0);
 }
 
 /* Read bend */
-void Parser::readBend(NoteEffect& effect)
+void Parser::readBend(RareNoteEffects& effects)
 {
 	skip(5);
-	auto bend = Bend();
+	auto bend = Bend(memoryResource());
 	auto numPoints = readInt();
+
+	// The count comes straight from the file, so make sure the points are
+	// all there before reading them
+	if (!canReadRecords(numPoints, POINT_RECORD_SIZE))
+		return;
 	for (auto i = 0; i < numPoints; ++i) {
 		auto bendPosition = readInt();
 		auto bendValue = readInt();
 		readByte();
 		auto p = BendPoint();
-		p.pointPosition = std::round(bendPosition *
+		p.pointPosition = std::round(static_cast<double>(bendPosition) *
 				TGEFFECTBEND_MAX_POSITION_LENGTH /
-				static_cast<double>(GP_BEND_POSITION));
-		p.pointValue = std::round(bendValue *
+				GP_BEND_POSITION);
+		p.pointValue = std::round(static_cast<double>(bendValue) *
 				TGEFFECTBEND_SEMITONE_LENGTH /
-				static_cast<double>(GP_BEND_SEMITONE));
+				GP_BEND_SEMITONE);
 		bend.points.push_back(p);
 	}
-	if (bend.points.size() > 0)
-		effect.bend = bend;
+	if (bend.points.size() > 0) {
+		effects.bend = std::move(bend);
+		effects.flags |= RARE_NOTE_EFFECT_BEND;
+	}
 }
 
 /* Read grace */
-void Parser::readGrace(NoteEffect& effect)
+void Parser::readGrace(RareNoteEffects& effects)
 {
 	auto fret = readUnsignedByte();
 	auto dynamic = readUnsignedByte();
@@ -828,75 +1558,222 @@ void Parser::readGrace(NoteEffect& effect)
 	grace.dead = (flags & 0x01) != 0;
 	grace.onBeat = (flags & 0x02) != 0;
 	if (transition == 0)
-		grace.transition = "none";
+		grace.transition = GraceTransition::None;
 	else if (transition == 1)
-		grace.transition = "slide";
+		grace.transition = GraceTransition::Slide;
 	else if (transition == 2)
-		grace.transition = "bend";
+		grace.transition = GraceTransition::Bend;
 	else if (transition == 3)
-		grace.transition = "hammer";
-	effect.grace = grace;
+		grace.transition = GraceTransition::Hammer;
+	effects.grace = grace;
+	effects.flags |= RARE_NOTE_EFFECT_GRACE;
 }
 
 /* Read tremolo picking */
-void Parser::readTremoloPicking(NoteEffect& effect)
+void Parser::readTremoloPicking(RareNoteEffects& effects)
 {
 	auto value = readUnsignedByte();
 	auto tp = TremoloPicking();
-	if (value == 1) {
-		tp.duration.value = "eigth";
-		effect.tremoloPicking = tp;
-	} else if (value == 2) {
-		tp.duration.value = "sixteenth";
-		effect.tremoloPicking = tp;
-	} else if (value == 3) {
-		tp.duration.value = "thirty_second";
-		effect.tremoloPicking = tp;
-	}
+	if (value == 1)
+		tp.duration.value = EffectDurationValue::Eighth;
+	else if (value == 2)
+		tp.duration.value = EffectDurationValue::Sixteenth;
+	else if (value == 3)
+		tp.duration.value = EffectDurationValue::ThirtySecond;
+	else
+		return;
+	effects.tremoloPicking = tp;
+	effects.flags |= RARE_NOTE_EFFECT_TREMOLO_PICKING;
 }
 
 /* Read artificial harmonic */
-void Parser::readArtificialHarmonic(NoteEffect& effect)
+void Parser::readArtificialHarmonic(RareNoteEffects& effects)
 {
 	auto type = readByte();
 	auto harmonic = Harmonic();
 	if (type == 1) {
-		harmonic.type = "natural";
-		effect.harmonic = harmonic;
+		harmonic.type = HarmonicType::Natural;
 	} else if (type == 2) {
 		skip(3);
-		harmonic.type = "artificial";
-		effect.harmonic = harmonic;
+		harmonic.type = HarmonicType::Artificial;
 	} else if (type == 3) {
 		skip(1);
-		harmonic.type = "tapped";
-		effect.harmonic = harmonic;
+		harmonic.type = HarmonicType::Tapped;
 	} else if (type == 4) {
-		harmonic.type = "pinch";
-		effect.harmonic = harmonic;
+		harmonic.type = HarmonicType::Pinch;
 	} else if (type == 5) {
-		harmonic.type = "semi";
-		effect.harmonic = harmonic;
+		harmonic.type = HarmonicType::Semi;
+	} else {
+		return;
 	}
+	effects.harmonic = harmonic;
+	effects.flags |= RARE_NOTE_EFFECT_HARMONIC;
 }
 
 /* Read trill */
-void Parser::readTrill(NoteEffect& effect)
+void Parser::readTrill(RareNoteEffects& effects)
 {
 	auto fret = readByte();
 	auto period = readByte();
 	auto trill = Trill();
 	trill.fret = fret;
-	if (period == 1) {
-		trill.duration.value = "sixteenth";
-		effect.trill = trill;
-	} else if (period == 2) {
-		trill.duration.value = "thirty_second";
-		effect.trill = trill;
-	} else if (period == 3) {
-		trill.duration.value = "sixty_fourth";
-		effect.trill = trill;
+	if (period == 1)
+		trill.duration.value = EffectDurationValue::Sixteenth;
+	else if (period == 2)
+		trill.duration.value = EffectDurationValue::ThirtySecond;
+	else if (period == 3)
+		trill.duration.value = EffectDurationValue::SixtyFourth;
+	else
+		return;
+	effects.trill = trill;
+	effects.flags |= RARE_NOTE_EFFECT_TRILL;
+}
+
+/* Skip a measure - this walks the same records as readMeasure, but only
+ * moves the position along without building any objects. Mix changes are
+ * still read, as they change the tempo for every track */
+template <std::size_t Version>
+void Parser::skipMeasure(Track& track, Tempo& tempo)
+{
+	for (auto voice = 0; voice < 2; ++voice) {
+		auto beats = readInt();
+		for (auto k = 0; k < beats && !truncated; ++k)
+			skipBeat<Version>(track, tempo);
+	}
+}
+
+/* Skip beat */
+template <std::size_t Version>
+void Parser::skipBeat(Track& track, Tempo& tempo)
+{
+	auto flags = readUnsignedByte();
+	if ((flags & 0x40) != 0)
+		skip(1);
+
+	// Duration
+	skip(1);
+	if ((flags & 0x20) != 0)
+		skip(4);
+
+	// Chord, which is always of a fixed size
+	if ((flags & 0x02) != 0)
+		skip(CHORD_RECORD_SIZE);
+	if ((flags & 0x04) != 0)
+		skipStringByteSizeOfInteger();
+	if ((flags & 0x08) != 0)
+		skipBeatEffects();
+	if ((flags & 0x10) != 0)
+		readMixChange<Version>(tempo);
+	auto stringFlags = readUnsignedByte();
+	for (auto i = 6; i >= 0; --i) {
+		if ((stringFlags & (1 << i)) != 0 && static_cast<std::size_t>(6 - i) < track.strings.size())
+			skipNote();
+	}
+
+	skip(1);
+
+	auto read = readByte();
+	if ((read & 0x02) != 0)
+		skip(1);
+}
+
+/* Skip beat effects */
+void Parser::skipBeatEffects()
+{
+	auto flags1 = readUnsignedByte();
+	auto flags2 = readUnsignedByte();
+	if ((flags1 & 0x20) != 0)
+		skip(1);
+	if ((flags2 & 0x04) != 0)
+		skipPoints();
+	if ((flags1 & 0x40) != 0)
+		skip(2);
+	if ((flags2 & 0x02) != 0)
+		skip(1);
+}
+
+/* Skip note */
+void Parser::skipNote()
+{
+	readingNote = true;
+	auto flags = readUnsignedByte();
+	if ((flags & 0x20) != 0)
+		skip(1);
+	if ((flags & 0x10) != 0)
+		skip(1);
+	if ((flags & 0x20) != 0)
+		skip(1);
+	if ((flags & 0x80) != 0)
+		skip(2);
+	if ((flags & 0x01) != 0)
+		skip(8);
+	skip(1);
+	if ((flags & 0x08) != 0)
+		skipNoteEffects();
+	readingNote = false;
+}
+
+/* Skip note effects */
+void Parser::skipNoteEffects()
+{
+	auto flags1 = readUnsignedByte();
+	auto flags2 = readUnsignedByte();
+	if ((flags1 & 0x01) != 0)
+		skipPoints();
+	if ((flags1 & 0x10) != 0)
+		skip(5);
+	if ((flags2 & 0x04) != 0)
+		skip(1);
+	if ((flags2 & 0x08) != 0)
+		skip(1);
+	if ((flags2 & 0x10) != 0) {
+		auto type = readByte();
+		if (type == 2)
+			skip(3);
+		else if (type == 3)
+			skip(1);
 	}
+	if ((flags2 & 0x20) != 0)
+		skip(2);
+}
+
+/* Skip the points of a bend or tremolo bar, each of which takes 9 bytes */
+void Parser::skipPoints()
+{
+	skip(5);
+	auto numPoints = readInt();
+	if (canReadRecords(numPoints, POINT_RECORD_SIZE))
+		skip(static_cast<std::size_t>(numPoints) * POINT_RECORD_SIZE);
+}
+
+/* Tests if the track at the supplied index is to be decoded, as per the
+ * track mask in the options */
+bool Parser::isTrackSelected(std::size_t index) const
+{
+	return options.trackMask.empty() ||
+	       (index < options.trackMask.size() && options.trackMask[index]);
+}
+
+/* This provides an empty track for the next track read, taking over the
+ * storage of a track from a previous tab where there is one */
+Track Parser::newTrack()
+{
+	auto track = Track(memoryResource());
+	if (!spareTracks.empty()) {
+		track.strings = std::move(spareTracks.back().strings);
+		track.measures = std::move(spareTracks.back().measures);
+		spareTracks.pop_back();
+	}
+
+	return track;
+}
+
+/* This returns the memory resource which the measures are allocated from */
+std::pmr::memory_resource *Parser::memoryResource() const
+{
+	return options.memoryResource != nullptr
+		? options.memoryResource
+		: std::pmr::get_default_resource();
 }
 
 /* Tests if the channel corresponding to the supplied id is a
@@ -912,16 +1789,16 @@ bool Parser::isPercussionChannel(std::int32_t channelId)
 }
 
 /* Get clef */
-std::string Parser::getClef(Track& track)
+Clef Parser::getClef(Track& track)
 {
 	if (!isPercussionChannel(track.channelId)) {
 		for (auto& string : track.strings) {
 			if (string.value <= 34)
-				return "CLEF_BASS";
+				return Clef::Bass;
 		}
 	}	
 
-	return "CLEF_TREBLE";
+	return Clef::Treble;
 }
 
 /* This generates the same state as the XML blob, but in object
@@ -935,11 +1812,294 @@ TabFile Parser::getTabFile()
 		       trackCount, measureHeaders, tracks);
 }
 
+/* This moves the decoded tab out of the parser into a song which owns it,
+ * releasing any mapping of the file straight away. The parser is left empty,
+ * as per reset, and can go on to parse the next tab - the song takes the
+ * tracks and everything else it holds, but the capacity of the file buffer
+ * and of the tied note states is kept, as are the tracks kept from tabs
+ * before it which were not taken */
+Song Parser::takeSong()
+{
+	if (phase != ParsePhase::Complete)
+		throw std::logic_error("Song needs a complete parse");
+
+	auto song = Song();
+	song.major = major;
+	song.minor = minor;
+	song.title = std::move(title);
+	song.subtitle = std::move(subtitle);
+	song.artist = std::move(artist);
+	song.album = std::move(album);
+	song.lyricsAuthor = std::move(lyricsAuthor);
+	song.musicAuthor = std::move(musicAuthor);
+	song.copyright = std::move(copyright);
+	song.tab = std::move(tab);
+	song.instructions = std::move(instructions);
+	song.comments = std::move(comments);
+	song.lyric = std::move(lyric);
+	song.tempoValue = tempoValue;
+	song.globalKeySignature = globalKeySignature;
+	song.channels = std::move(channels);
+	song.measures = measures;
+	song.trackCount = trackCount;
+	song.measureHeaders = std::move(measureHeaders);
+	song.tracks = std::move(tracks);
+	song.noteColumns = std::move(noteColumns);
+
+	// Leave nothing behind which could still be decoded
+	tracks.clear();
+	reset();
+
+	return song;
+}
+
+/* This creates an index of where each measure of each track starts, along
+ * with the tempo and tied note state carried into it, by decoding the
+ * measures again one at a time. The tracks need not have been decoded by
+ * the parse, so this also works on a header only parser */
+MeasureIndex Parser::createMeasureIndex()
+{
+	if (phase != ParsePhase::Complete)
+		throw std::logic_error("Measure index needs a complete parse");
+
+	auto index = MeasureIndex();
+	index.fileSize = fileBuffer.size();
+	index.measures = measures;
+	index.trackCount = trackCount;
+
+	// Walk the measures from the start, keeping the start, the tempo and the
+	// tied note state of each track up to date as we go
+	auto start = QUARTER_TIME;
+	auto tempo = Tempo();
+	tempo.value = tempoValue;
+	std::vector<TiedNoteState> states(tracks.size());
+	bufferPosition = measuresPosition;
+	truncated = false;
+	for (auto i = 0; i < measures && trackCount > 0; ++i) {
+		index.measureStarts.push_back(start);
+		for (auto j = 0; j < trackCount; ++j) {
+			auto entry = MeasureIndexEntry();
+			entry.position = bufferPosition;
+			entry.tempo = tempo.value;
+			entry.tiedNotes = states[j];
+			index.entries.push_back(entry);
+			auto measure = Measure(memoryResource());
+			measure.header = &measureHeaders[i];
+			measure.start = start;
+			(this->*measureReader)(measure, tracks[j], tempo, states[j], globalKeySignature);
+			skip(1);
+		}
+		index.measureTempos.push_back(tempo.value);
+		if (!addLength(start, measureHeaders[i]))
+			throw std::logic_error("Invalid tab file");
+	}
+	if (truncated)
+		throw std::logic_error("Truncated file");
+
+	return index;
+}
+
+/* This decodes a single measure of a single track straight from the file
+ * buffer using an index, without reading any of the measures before it. The
+ * parser only needs to have read the header of the file for this to work, so
+ * can be created with the header only option. The tied note state of the
+ * track is taken from the index, and is left as it stands at the end of the
+ * measure */
+Measure Parser::decodeMeasure(const MeasureIndex& index, std::int32_t measureIndex, std::int32_t trackIndex)
+{
+	auto& entry = findIndexEntry(index, measureIndex, trackIndex);
+
+	return decodeMeasure(index, measureIndex, trackIndex, entry.tiedNotes);
+}
+
+/* This decodes a single measure of a single track as per decodeMeasure, but
+ * carries in the tied note state the track has in the parser - as left by
+ * the last measure of the track decoded, or as set by setTiedNoteState -
+ * instead of the one in the index */
+Measure Parser::decodeMeasureFromTiedNoteState(const MeasureIndex& index, std::int32_t measureIndex, std::int32_t trackIndex)
+{
+	findIndexEntry(index, measureIndex, trackIndex);
+
+	return decodeMeasure(index, measureIndex, trackIndex, tiedNoteStates[trackIndex]);
+}
+
+/* This checks that an index matches the parsed file, and returns its entry
+ * for a single measure of a single track */
+const MeasureIndexEntry& Parser::findIndexEntry(const MeasureIndex& index, std::int32_t measureIndex, std::int32_t trackIndex) const
+{
+	if (phase != ParsePhase::Complete || index.fileSize != fileBuffer.size() ||
+	    index.measures != measures || index.trackCount != trackCount ||
+	    static_cast<std::size_t>(trackCount) != tracks.size() ||
+	    static_cast<std::size_t>(measures) != measureHeaders.size() ||
+	    index.measureStarts.size() != measureHeaders.size() ||
+	    index.measureTempos.size() != measureHeaders.size() ||
+	    index.entries.size() != static_cast<std::size_t>(measures) * trackCount)
+		throw std::logic_error("Measure index does not match file");
+	if (measureIndex < 0 || measureIndex >= measures || trackIndex < 0 || trackIndex >= trackCount)
+		throw std::logic_error("Measure out of range");
+
+	auto& entry = index.entries[static_cast<std::size_t>(measureIndex) * trackCount + trackIndex];
+	if (entry.position > fileBuffer.size())
+		throw std::logic_error("Measure index does not match file");
+
+	return entry;
+}
+
+/* This decodes a single measure of a single track from the position held in
+ * an index which has already been checked, carrying in the supplied tied
+ * note state and leaving the tied note state of the track as it stands at
+ * the end of the measure */
+Measure Parser::decodeMeasure(const MeasureIndex& index, std::int32_t measureIndex, std::int32_t trackIndex,
+			      TiedNoteState tiedNotes)
+{
+	// Lay out the header from the index, as a header only parse will not
+	// have done so
+	auto& entry = index.entries[static_cast<std::size_t>(measureIndex) * trackCount + trackIndex];
+	auto& header = measureHeaders[measureIndex];
+	header.start = index.measureStarts[measureIndex];
+	header.tempo.value = index.measureTempos[measureIndex];
+
+	// Decode the measure, carrying in the supplied tied notes
+	auto measure = Measure(memoryResource());
+	measure.header = &header;
+	measure.start = header.start;
+	auto tempo = Tempo();
+	tempo.value = entry.tempo;
+	bufferPosition = entry.position;
+	truncated = false;
+	(this->*measureReader)(measure, tracks[trackIndex], tempo, tiedNotes, globalKeySignature);
+	if (truncated)
+		throw std::logic_error(getName(failure.code));
+	tiedNoteStates[trackIndex] = tiedNotes;
+
+	return measure;
+}
+
+/* This returns the value last sounded on each string of a track, which is
+ * what a tied note at the start of the next measure decoded will take */
+TiedNoteState Parser::getTiedNoteState(std::int32_t trackIndex) const
+{
+	if (trackIndex < 0 || static_cast<std::size_t>(trackIndex) >= tiedNoteStates.size())
+		throw std::logic_error("Track out of range");
+
+	return tiedNoteStates[trackIndex];
+}
+
+/* This sets the value last sounded on each string of a track, which is what
+ * a tied note at the start of the next measure decoded with
+ * decodeMeasureFromTiedNoteState will take, so that decoding can carry on
+ * from an arbitrary measure */
+void Parser::setTiedNoteState(std::int32_t trackIndex, const TiedNoteState& state)
+{
+	if (trackIndex < 0 || static_cast<std::size_t>(trackIndex) >= tiedNoteStates.size())
+		throw std::logic_error("Track out of range");
+
+	tiedNoteStates[trackIndex] = state;
+}
+
+/* This returns the columns holding every decoded note, which are only filled
+ * in when the note columns option is set */
+const NoteColumns& Parser::getNoteColumns() const
+{
+	return noteColumns;
+}
+
+/* This appends every note of a decoded measure to the note columns */
+void Parser::addToNoteColumns(std::int32_t trackIndex, const Measure& measure)
+{
+	for (auto& beat : measure.beats) {
+		for (auto& voice : beat.voices) {
+			for (auto& note : voice.notes) {
+				noteColumns.ticks.push_back(beat.start);
+				noteColumns.durations.push_back(voice.duration);
+				noteColumns.tracks.push_back(trackIndex);
+				noteColumns.strings.push_back(static_cast<std::int8_t>(note.string));
+				noteColumns.frets.push_back(note.value);
+				noteColumns.velocities.push_back(note.velocity);
+				noteColumns.effectFlags.push_back(note.effect.flags);
+				noteColumns.rareEffectFlags.push_back(measure.getRareNoteEffects(note.effect).flags);
+			}
+		}
+	}
+}
+
+/* This empties the columns, keeping their capacity */
+void NoteColumns::clear()
+{
+	ticks.clear();
+	durations.clear();
+	tracks.clear();
+	strings.clear();
+	frets.clear();
+	velocities.clear();
+	effectFlags.clear();
+	rareEffectFlags.clear();
+}
+
+/* This returns the descriptive information about the tab, which is
+ * available whether or not its measures have been read */
+TabMetadata Parser::getMetadata() const
+{
+	auto metadata = TabMetadata();
+	metadata.title = title;
+	metadata.subtitle = subtitle;
+	metadata.artist = artist;
+	metadata.album = album;
+	metadata.lyricsAuthor = lyricsAuthor;
+	metadata.musicAuthor = musicAuthor;
+	metadata.copyright = copyright;
+	metadata.tempoValue = tempoValue;
+	metadata.measures = measures;
+	metadata.trackCount = trackCount;
+	for (auto& track : tracks)
+		metadata.trackNames.push_back(track.name);
+
+	return metadata;
+}
+
+/* This returns views of the descriptive information within the file buffer,
+ * which stay valid until the parser is reset or destroyed */
+const TabMetadataView& Parser::getMetadataView() const
+{
+	return metadataView;
+}
+
+/* This reads just the descriptive information from a tab file, stopping
+ * after the track table - with the default memory mapped backend only the
+ * pages holding the header are ever read from disk */
+TabMetadata readMetadata(const char *filePath, InputBackend backend)
+{
+	auto options = ParseOptions();
+	options.backend = backend;
+	options.headerOnly = true;
+
+	return Parser(filePath, options).getMetadata();
+}
+
+/* This reads just the descriptive information from a tab file already held
+ * in the supplied buffer, which can be memory mapped, without copying the
+ * title, artist, track names and other text fields - the views returned are
+ * only valid for as long as the buffer. Only those fields avoid copies: the
+ * header is still read by a parser, which allocates the channels, the tracks,
+ * the lyrics and the list of track names as it goes */
+TabMetadataView readMetadataView(const InputBuffer& buffer)
+{
+	auto options = ParseOptions();
+	options.headerOnly = true;
+
+	auto parser = Parser(options);
+	parser.copyText = false;
+	parser.fileBuffer.borrow(reinterpret_cast<const std::byte *>(buffer.data()), buffer.size());
+	parser.parse();
+
+	return std::move(parser.metadataView);
+}
+
 /* Tells us how many digits there are in a base 10 number */
 std::int32_t numOfDigits(std::int32_t num)
 {
 	auto digits = 0;
-	for (auto order = 1; num / order != 0; order *= 10)
+	for (auto rest = num; rest != 0; rest /= 10)
 		++digits;
 
 	return digits;
@@ -5,9 +5,17 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <string>
-#include <sstream>
+#include <string_view>
+#include <ostream>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <type_traits>
 
 namespace gp_parser {
 
@@ -25,15 +33,183 @@ static const int GP_BEND_POSITION = 60;
 static const int TGVELOCITIES_MIN_VELOCITY = 15;
 static const int TGVELOCITIES_VELOCITY_INCREMENT = 16;
 
+// Note effect flags, held together in a single word by each note
+static const std::uint16_t NOTE_EFFECT_FADE_IN = 0x0001;
+static const std::uint16_t NOTE_EFFECT_VIBRATO = 0x0002;
+static const std::uint16_t NOTE_EFFECT_TAPPING = 0x0004;
+static const std::uint16_t NOTE_EFFECT_SLAPPING = 0x0008;
+static const std::uint16_t NOTE_EFFECT_POPPING = 0x0010;
+static const std::uint16_t NOTE_EFFECT_DEAD_NOTE = 0x0020;
+static const std::uint16_t NOTE_EFFECT_ACCENTUATED_NOTE = 0x0040;
+static const std::uint16_t NOTE_EFFECT_HEAVY_ACCENTUATED_NOTE = 0x0080;
+static const std::uint16_t NOTE_EFFECT_GHOST_NOTE = 0x0100;
+static const std::uint16_t NOTE_EFFECT_SLIDE = 0x0200;
+static const std::uint16_t NOTE_EFFECT_HAMMER = 0x0400;
+static const std::uint16_t NOTE_EFFECT_LET_RING = 0x0800;
+static const std::uint16_t NOTE_EFFECT_PALM_MUTE = 0x1000;
+static const std::uint16_t NOTE_EFFECT_STACCATO = 0x2000;
+
+// Rare note effect flags, telling which of the rare effects a note has
+static const std::uint8_t RARE_NOTE_EFFECT_TREMOLO_BAR = 0x01;
+static const std::uint8_t RARE_NOTE_EFFECT_TREMOLO_PICKING = 0x02;
+static const std::uint8_t RARE_NOTE_EFFECT_BEND = 0x04;
+static const std::uint8_t RARE_NOTE_EFFECT_GRACE = 0x08;
+static const std::uint8_t RARE_NOTE_EFFECT_HARMONIC = 0x10;
+static const std::uint8_t RARE_NOTE_EFFECT_TRILL = 0x20;
+
+// Index held by notes without any rare effects
+static const std::int32_t NO_RARE_NOTE_EFFECTS = -1;
+
 // Spacing for XML output
 #define XML_SPACING "    "
 
+// Define the backends which can be used to supply file data to the parser
+enum class InputBackend {
+	Buffered,
+	MemoryMapped
+};
+
+// Define input buffer class, which holds the raw bytes of a tab file - these
+// are either read into memory, mapped read-only straight from the file when
+// the memory mapped backend is selected and the file supports it, moved in by
+// the caller or borrowed from the caller without a copy
+class InputBuffer {
+public:
+	InputBuffer() = default;
+	InputBuffer(const char *filePath, InputBackend backend);
+	InputBuffer(const std::byte *data, std::size_t size);
+	InputBuffer(std::vector<char>&& bytes);
+	InputBuffer(InputBuffer&& other) noexcept;
+	InputBuffer& operator=(InputBuffer&& other) noexcept;
+	InputBuffer(const InputBuffer&) = delete;
+	InputBuffer& operator=(const InputBuffer&) = delete;
+	~InputBuffer();
+
+	void load(const char *filePath, InputBackend backend);
+	bool tryLoad(const char *filePath, InputBackend backend);
+	void borrow(const std::byte *data, std::size_t size);
+	void clear();
+
+	const char *data() const { return bytes; }
+	std::size_t size() const { return length; }
+	bool isMapped() const { return mapping != nullptr; }
+private:
+	std::vector<char> buffer;
+	void *mapping = nullptr;
+	const char *bytes = nullptr;
+	std::size_t length = 0;
+
+	bool map(const char *filePath);
+	bool read(const char *filePath);
+	void release();
+};
+
+// Define the enumerations used within the tab, along with the names they are
+// given in the XML output - the first value of those which may be left unset
+// has an empty name
+enum class ChannelBank : std::uint8_t {
+	Default,
+	DefaultPercussion
+};
+static constexpr const char *CHANNEL_BANK_NAMES[] = {
+	"default bank",
+	"default percussion bank"
+};
+
+enum class TripletFeel : std::uint8_t {
+	None,
+	Eighth,
+	Sixteenth
+};
+static constexpr const char *TRIPLET_FEEL_NAMES[] = {
+	"none",
+	"eigth",
+	"sixteents"
+};
+
+enum class Clef : std::uint8_t {
+	Treble,
+	Bass
+};
+static constexpr const char *CLEF_NAMES[] = {
+	"CLEF_TREBLE",
+	"CLEF_BASS"
+};
+
+enum class GraceTransition : std::uint8_t {
+	Unset,
+	None,
+	Slide,
+	Bend,
+	Hammer
+};
+static constexpr const char *GRACE_TRANSITION_NAMES[] = {
+	"",
+	"none",
+	"slide",
+	"bend",
+	"hammer"
+};
+
+enum class EffectDurationValue : std::uint8_t {
+	Unset,
+	Eighth,
+	Sixteenth,
+	ThirtySecond,
+	SixtyFourth
+};
+static constexpr const char *EFFECT_DURATION_VALUE_NAMES[] = {
+	"",
+	"eigth",
+	"sixteenth",
+	"thirty_second",
+	"sixty_fourth"
+};
+
+enum class HarmonicType : std::uint8_t {
+	Unset,
+	Natural,
+	Artificial,
+	Tapped,
+	Pinch,
+	Semi
+};
+static constexpr const char *HARMONIC_TYPE_NAMES[] = {
+	"",
+	"natural",
+	"artificial",
+	"tapped",
+	"pinch",
+	"semi"
+};
+
+enum class StrokeDirection : std::uint8_t {
+	Unset,
+	StrokeUp,
+	StrokeDown
+};
+static constexpr const char *STROKE_DIRECTION_NAMES[] = {
+	"",
+	"stroke_up",
+	"stroke_down"
+};
+
+constexpr const char *getName(ChannelBank value) { return CHANNEL_BANK_NAMES[static_cast<std::size_t>(value)]; }
+constexpr const char *getName(TripletFeel value) { return TRIPLET_FEEL_NAMES[static_cast<std::size_t>(value)]; }
+constexpr const char *getName(Clef value) { return CLEF_NAMES[static_cast<std::size_t>(value)]; }
+constexpr const char *getName(GraceTransition value) { return GRACE_TRANSITION_NAMES[static_cast<std::size_t>(value)]; }
+constexpr const char *getName(EffectDurationValue value) { return EFFECT_DURATION_VALUE_NAMES[static_cast<std::size_t>(value)]; }
+constexpr const char *getName(HarmonicType value) { return HARMONIC_TYPE_NAMES[static_cast<std::size_t>(value)]; }
+constexpr const char *getName(StrokeDirection value) { return STROKE_DIRECTION_NAMES[static_cast<std::size_t>(value)]; }
+
+class XmlWriter;
+
 // Define struct to hold lyrics data
 struct Lyric {
 	std::int32_t from;
 	std::string lyric;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define channel parameter struct
@@ -41,7 +217,7 @@ struct ChannelParam {
 	std::string key;
 	std::string value;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t identLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define channel struct
@@ -55,11 +231,11 @@ struct Channel {
 	std::int8_t reverb;
 	std::int8_t phaser;
 	std::int8_t tremolo;
-	std::string bank;
+	ChannelBank bank;
 	bool isPercussionChannel;
 	std::vector<ChannelParam> parameters;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define division struct
@@ -67,7 +243,7 @@ struct Division {
 	std::int32_t enters;
 	std::int32_t times;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define denominator struct
@@ -75,7 +251,7 @@ struct Denominator {
 	std::int8_t value;
 	Division division;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define duration struct
@@ -91,7 +267,7 @@ struct TimeSignature {
 	std::int8_t numerator;
 	Denominator denominator;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define color struct
@@ -100,7 +276,7 @@ struct Color {
 	std::uint8_t g;
 	std::uint8_t b;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define measure marker struct
@@ -109,14 +285,14 @@ struct Marker {
 	std::string title;
 	Color color;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define tempo struct
 struct Tempo {
 	std::int32_t value;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define measure header struct
@@ -126,12 +302,12 @@ struct MeasureHeader {
 	bool repeatOpen;
 	std::int8_t repeatClose;	
 	std::uint8_t repeatAlternative;
-	std::string tripletFeel;
+	TripletFeel tripletFeel;
 	Tempo tempo;
 	TimeSignature timeSignature;
 	Marker marker;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define tremolo point struct
@@ -139,14 +315,17 @@ struct TremoloPoint {
 	std::int32_t pointPosition;
 	std::int32_t pointValue;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define tremolo bar struct
 struct TremoloBar {
-	std::vector<TremoloPoint> points;
+	std::pmr::vector<TremoloPoint> points;
+
+	TremoloBar() = default;
+	explicit TremoloBar(std::pmr::memory_resource *resource) : points(resource) {}
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define bend point struct
@@ -154,48 +333,51 @@ struct BendPoint {
 	std::int32_t pointPosition;
 	std::int32_t pointValue;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define bend struct
 struct Bend {
-	std::vector<BendPoint> points;
+	std::pmr::vector<BendPoint> points;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	Bend() = default;
+	explicit Bend(std::pmr::memory_resource *resource) : points(resource) {}
+
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define grace struct
 struct Grace {
 	std::uint8_t fret;
 	std::int32_t dynamic;
-	std::string transition;
+	GraceTransition transition;
 	std::uint8_t duration;
 	bool dead;
 	bool onBeat;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define effect duration struct
 struct EffectDuration {
-	std::string value;
+	EffectDurationValue value;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define tremolo picking struct
 struct TremoloPicking {
 	EffectDuration duration;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define harmonic struct
 struct Harmonic {
-	std::string type;
+	HarmonicType type;
 	std::int32_t data;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define trill struct
@@ -203,33 +385,39 @@ struct Trill {
 	std::int8_t fret;
 	EffectDuration duration;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
-// Define note effect struct
-struct NoteEffect {
-	bool fadeIn;
-	bool vibrato;
-	bool tapping;
-	bool slapping;
-	bool popping;
-	bool deadNote;
-	bool accentuatedNote;
-	bool heavyAccentuatedNote;
-	bool ghostNote;
-	bool slide;
-	bool hammer;
-	bool letRing;
-	bool palmMute;
-	bool staccato;
+// Define rare note effects struct, which holds the effects that only a few
+// notes have and that are too large to keep with every note - notes refer to
+// these by their index within the measure
+struct RareNoteEffects {
 	TremoloBar tremoloBar;
 	TremoloPicking tremoloPicking;
 	Bend bend;
 	Grace grace;
 	Harmonic harmonic;
 	Trill trill;
+	std::uint8_t flags = 0;
+
+	RareNoteEffects() = default;
+	explicit RareNoteEffects(std::pmr::memory_resource *resource)
+		: tremoloBar(resource), tremoloPicking(), bend(resource), grace(), harmonic(), trill() {}
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	bool hasFlag(std::uint8_t flag) const { return (flags & flag) != 0; }
+};
+
+struct Measure;
+
+// Define note effect struct, which holds the note effect flags along with the
+// index of the note's rare effects within its measure
+struct NoteEffect {
+	std::uint16_t flags = 0;
+	std::int32_t rareEffects = NO_RARE_NOTE_EFFECTS;
+
+	bool hasFlag(std::uint16_t flag) const { return (flags & flag) != 0; }
+	void setFlag(std::uint16_t flag, bool value) { flags = value ? flags | flag : flags & ~flag; }
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel, const Measure& measure) const;
 };
 
 // Define note struct
@@ -240,24 +428,27 @@ struct Note {
 	std::int32_t velocity;
 	NoteEffect effect;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel, const Measure& measure) const;
 };
 
 // Define voice struct
 struct Voice {
 	bool empty;
 	double duration;	
-	std::vector<Note> notes;
+	std::pmr::vector<Note> notes;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	Voice() = default;
+	explicit Voice(std::pmr::memory_resource *resource) : empty(), duration(), notes(resource) {}
+
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel, const Measure& measure) const;
 };
 
 // Define stroke struct
 struct Stroke {
-	std::string direction;
-	std::string value;
+	StrokeDirection direction;
+	StrokeDirection value;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define guitar string struct
@@ -265,23 +456,29 @@ struct GuitarString {
 	std::int32_t number;
 	std::int32_t value;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define chord struct
 struct Chord {
-	std::string name;
+	std::pmr::string name;
 	std::vector<GuitarString>* strings;
-	std::vector<std::int32_t> frets;
+	std::pmr::vector<std::int32_t> frets;
+
+	Chord() = default;
+	explicit Chord(std::pmr::memory_resource *resource) : name(resource), strings(), frets(resource) {}
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define beat text struct
 struct BeatText {
-	std::string value;
+	std::pmr::string value;
+
+	BeatText() = default;
+	explicit BeatText(std::pmr::memory_resource *resource) : value(resource) {}
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define beat struct
@@ -290,9 +487,13 @@ struct Beat {
 	BeatText text;
 	Stroke stroke;
 	Chord chord;
-	std::vector<Voice> voices;
+	std::pmr::vector<Voice> voices;
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	Beat() = default;
+	explicit Beat(std::pmr::memory_resource *resource)
+		: start(), text(resource), stroke(), chord(resource), voices(resource) {}
+
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel, const Measure& measure) const;
 };
 
 // Define measure struct
@@ -300,10 +501,16 @@ struct Measure {
 	MeasureHeader *header;
 	std::int32_t start;
 	std::int8_t keySignature;
-	std::string clef;
-	std::vector<Beat> beats;
+	Clef clef;
+	std::pmr::vector<Beat> beats;
+	std::pmr::vector<RareNoteEffects> rareNoteEffects;
+
+	Measure() = default;
+	explicit Measure(std::pmr::memory_resource *resource)
+		: header(), start(), keySignature(), clef(), beats(resource), rareNoteEffects(resource) {}
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+	const RareNoteEffects& getRareNoteEffects(const NoteEffect& effect) const;
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
 };
 
 // Define track struct
@@ -315,9 +522,322 @@ struct Track {
 	Lyric lyrics;
 	Color color;
 	std::vector<GuitarString> strings;
-	std::vector<Measure> measures;
+	std::pmr::vector<Measure> measures;
+
+	Track() = default;
+	explicit Track(std::pmr::memory_resource *resource)
+		: channelId(), number(), offset(), lyrics(), color(), measures(resource) {}
+
+	void addToXML(XmlWriter& writer, std::int32_t indentLevel) const;
+};
+
+// Define tied note state struct, which holds the value of the last note on
+// each string of a track (or -1 where there is none yet) so that tied notes
+// can be resolved
+struct TiedNoteState {
+	std::int8_t frets[7] = {-1, -1, -1, -1, -1, -1, -1};
+};
+
+// Define measure index entry struct, which records where a single measure of a
+// single track starts within the file, along with the tempo and tied note state
+// carried into it
+struct MeasureIndexEntry {
+	std::uint64_t position;
+	std::int32_t tempo;
+	TiedNoteState tiedNotes;
+};
 
-	void addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const;
+// Define measure index struct, which lets any measure of any track be decoded
+// directly once a file has been fully parsed once. Entries are held measure by
+// measure, with a track's entry at (measure * trackCount + track). The index
+// can be saved next to the file and loaded back later
+struct MeasureIndex {
+	std::uint64_t fileSize;
+	std::int32_t measures;
+	std::int32_t trackCount;
+	std::vector<std::int32_t> measureStarts;
+	std::vector<std::int32_t> measureTempos;
+	std::vector<MeasureIndexEntry> entries;
+
+	std::vector<char> toBytes() const;
+	static MeasureIndex fromBytes(const char *data, std::size_t size);
+	void save(const char *filePath) const;
+	static MeasureIndex load(const char *filePath);
+};
+
+// Define callback type used to report each measure of each track as soon as
+// it has been decoded
+typedef std::function<void(const Track& track, const Measure& measure)> MeasureCallback;
+
+// Define options struct used to configure how a parser reads a tab file
+struct ParseOptions {
+	InputBackend backend = InputBackend::Buffered;
+	MeasureCallback measureCallback;
+	bool headerOnly = false;
+
+	// Tracks to decode the measures of, by index, or every track when empty -
+	// the others keep their name, strings and channel but have no measures
+	std::vector<bool> trackMask;
+
+	// Above one, a whole file has its measures decoded in parallel
+	std::size_t threadCount = 1;
+
+	// Gather every decoded note into note columns too
+	bool buildNoteColumns = false;
+
+	// Where the measures, down to their notes and effects, are allocated -
+	// everything else comes from the global heap. It must be safe to share
+	// between threads when more than one thread is used
+	std::pmr::memory_resource *memoryResource = std::pmr::get_default_resource();
+};
+
+// Define note columns struct, which holds every decoded note of every track in
+// struct-of-arrays form, in the order the notes appear in the file - entry i of
+// each column describes the same note. Scanning a column touches nothing but
+// that column, so analysis over every note stays cache friendly. The effect
+// flags are the note effect flags, and the rare effect flags tell which of
+// the rare effects the note has, so every technique can be found from the
+// columns alone
+struct NoteColumns {
+	std::vector<std::int32_t> ticks;
+	std::vector<double> durations;
+	std::vector<std::int32_t> tracks;
+	std::vector<std::int8_t> strings;
+	std::vector<std::int8_t> frets;
+	std::vector<std::int32_t> velocities;
+	std::vector<std::uint16_t> effectFlags;
+	std::vector<std::uint8_t> rareEffectFlags;
+
+	std::size_t size() const { return ticks.size(); }
+	void clear();
+};
+
+// Define metadata struct, which holds the descriptive information about a tab
+// without any of its measures - this is all that a header only parse provides
+struct TabMetadata {
+	std::string title;
+	std::string subtitle;
+	std::string artist;
+	std::string album;
+	std::string lyricsAuthor;
+	std::string musicAuthor;
+	std::string copyright;
+	std::int32_t tempoValue;
+	std::int32_t measures;
+	std::int32_t trackCount;
+	std::vector<std::string> trackNames;
+};
+
+// Define metadata view struct, which holds the same information as the
+// metadata struct but as views straight into the bytes of the tab file, so
+// it is only valid for as long as those bytes are
+struct TabMetadataView {
+	std::string_view title;
+	std::string_view subtitle;
+	std::string_view artist;
+	std::string_view album;
+	std::string_view lyricsAuthor;
+	std::string_view musicAuthor;
+	std::string_view copyright;
+	std::int32_t tempoValue = 0;
+	std::int32_t measures = 0;
+	std::int32_t trackCount = 0;
+	std::vector<std::string_view> trackNames;
+};
+
+// Define the phases a parser moves through as it reads a tab file
+enum class ParsePhase {
+	Header,
+	Channels,
+	MeasureHeaders,
+	Tracks,
+	Measures,
+	Complete
+};
+
+// Define the reasons a tab can fail to parse, along with the messages given
+// when they are thrown
+enum class ParseErrorCode : std::uint8_t {
+	None,
+	NullInput,
+	UnableToOpen,
+	UnsupportedVersion,
+	Truncated,
+	OutOfMemory,
+	Invalid
+};
+static constexpr const char *PARSE_ERROR_CODE_NAMES[] = {
+	"",
+	"Null input passed to parse",
+	"Unable to open file",
+	"Unsupported version",
+	"Truncated file",
+	"Out of memory",
+	"Invalid tab file"
+};
+
+// Define the parts of a tab file a parse error can be found in
+enum class ParseStage : std::uint8_t {
+	Header,
+	Channels,
+	MeasureHeaders,
+	Tracks,
+	Beats,
+	Notes
+};
+static constexpr const char *PARSE_STAGE_NAMES[] = {
+	"header",
+	"channels",
+	"measure headers",
+	"tracks",
+	"beats",
+	"notes"
+};
+
+constexpr const char *getName(ParseErrorCode value) { return PARSE_ERROR_CODE_NAMES[static_cast<std::size_t>(value)]; }
+constexpr const char *getName(ParseStage value) { return PARSE_STAGE_NAMES[static_cast<std::size_t>(value)]; }
+
+// Define parse result struct, which reports whether a tab parsed without
+// throwing, and if not why, where in the file and in what part of it
+struct ParseResult {
+	ParseErrorCode code = ParseErrorCode::None;
+	std::size_t offset = 0;
+	ParseStage stage = ParseStage::Header;
+
+	bool succeeded() const { return code == ParseErrorCode::None; }
+};
+
+// Define the XML profiles - full XML holds every element, indented. Compact
+// XML is not indented and leaves out any element holding zero, false, empty
+// text or the first value of an enumeration, along with any element left with
+// nothing inside it, such as the effects of a note with none. The items of a
+// list are always kept, so that they stay in order. A missing element is read
+// as holding its default, which gives back the full XML. Normalized XML writes
+// each measure header once, in the list of measure headers - each measure
+// just holds the number of its header in a Header element. The strings of a
+// chord are left out too, as a chord with frets always has the strings of the
+// track holding it. Compact and normalized XML can be had together
+enum class XmlProfile : std::uint8_t {
+	Full,
+	Compact,
+	Normalized,
+	CompactNormalized
+};
+static constexpr const char *XML_PROFILE_NAMES[] = {
+	"full",
+	"compact",
+	"normalized",
+	"compact normalized"
+};
+
+constexpr const char *getName(XmlProfile value) { return XML_PROFILE_NAMES[static_cast<std::size_t>(value)]; }
+
+// Define XML sink type, which is handed each chunk of XML as it is written
+// so that a document can go straight to a file, socket or compressor
+typedef std::function<void(const char *data, std::size_t size)> XmlSink;
+
+// Define XML writer class, which every addToXML function appends to - text is
+// copied straight into a fixed size buffer, numbers are formatted with to_chars
+// rather than through a stream and its locale, and indentation is copied from
+// a table rather than a level at a time. Each time the buffer fills, it is
+// appended to the supplied string or passed to the supplied sink, so flush
+// must be called once everything has been written. For compact XML, opening
+// tags are held back until something is written inside them, so that empty
+// elements can be dropped along with their closing tags
+class XmlWriter {
+public:
+	explicit XmlWriter(std::string& output, XmlProfile profile = XmlProfile::Full, std::size_t bufferSize = 64 * 1024);
+	explicit XmlWriter(const XmlSink& sink, XmlProfile profile = XmlProfile::Full, std::size_t bufferSize = 64 * 1024);
+	XmlWriter(const XmlWriter&) = delete;
+	XmlWriter& operator=(const XmlWriter&) = delete;
+
+	bool omitsDefaults() const { return profile == XmlProfile::Compact || profile == XmlProfile::CompactNormalized; }
+	bool normalizes() const { return profile == XmlProfile::Normalized || profile == XmlProfile::CompactNormalized; }
+	void flush();
+	void indent(std::int32_t indentLevel);
+	void append(std::int32_t value);
+	void append(std::uint32_t value);
+	void append(double value);
+	void append(const char *text) { append(std::string_view(text)); }
+	void append(bool value) { append(value ? std::string_view("true") : std::string_view("false")); }
+	void append(std::string_view text)
+	{
+		if (text.size() > static_cast<std::size_t>(end - position)) {
+			appendLarge(text);
+			return;
+		}
+		std::memcpy(position, text.data(), text.size());
+		position += text.size();
+	}
+	template <class E, std::enable_if_t<std::is_enum_v<E>, int> = 0>
+	void append(E value) { append(getName(value)); }
+
+	// Writes an indented line which is always kept
+	void line(std::int32_t indentLevel, std::string_view text)
+	{
+		if (!pendingTags.empty())
+			writePendingTags();
+		indent(indentLevel);
+		append(text);
+	}
+
+	// Writes the opening and closing tags of an element holding others - in
+	// compact XML, an element left empty is dropped unless it is kept
+	void openTag(std::int32_t indentLevel, std::string_view tag)
+	{
+		if (!omitsDefaults() || keepNext) {
+			keepNext = false;
+			line(indentLevel, tag);
+			return;
+		}
+		pendingTags.emplace_back(indentLevel, tag);
+	}
+	void closeTag(std::int32_t indentLevel, std::string_view tag)
+	{
+		if (!pendingTags.empty()) {
+			pendingTags.pop_back();
+			return;
+		}
+		line(indentLevel, tag);
+	}
+	void keepNextTag() { keepNext = true; }
+
+	// Writes an indented element holding a single value, which compact XML
+	// leaves out if it holds the default
+	template <class T>
+	void element(std::int32_t indentLevel, std::string_view openTag, const T& value, std::string_view closeTag)
+	{
+		if (omitsDefaults() && isDefault(value))
+			return;
+		item(indentLevel, openTag, value, closeTag);
+	}
+
+	// Writes an indented element holding a single value in a list, which is
+	// always kept
+	template <class T>
+	void item(std::int32_t indentLevel, std::string_view openTag, const T& value, std::string_view closeTag)
+	{
+		line(indentLevel, openTag);
+		append(value);
+		append(closeTag);
+	}
+private:
+	std::string *output = nullptr;
+	const XmlSink *sink = nullptr;
+	XmlProfile profile;
+	std::vector<char> buffer;
+	char *position;
+	char *end;
+	std::vector<std::pair<std::int32_t, std::string_view>> pendingTags;
+	bool keepNext = false;
+
+	template <class T>
+	static bool isDefault(const T& value) { return value == T(); }
+	static bool isDefault(const char *text) { return *text == '\0'; }
+
+	void appendLarge(std::string_view text);
+	void makeRoom(std::size_t size);
+	void writePendingTags();
 };
 
 // Define struct to return overall tab - it only contains references to real values
@@ -361,17 +881,12 @@ struct TabFile {
 		  measureHeaders(measureHeaders), tracks(tracks) {}
 };
 
-class Parser {
-public:
-	Parser(const char *filePath);
-	std::string getXML() const;
-	TabFile getTabFile();
-private:
-	// Private member properties
-	std::vector<char> fileBuffer;
-	std::size_t bufferPosition = 0;
-	std::string version;
-	std::size_t versionIndex;
+// Define song struct, which owns the whole decoded tab once it has been taken
+// from a parser, so that it can outlive the parser and be moved between
+// threads. Measures point at the measure headers and chords at the strings of
+// their track, so songs can be moved but not copied. Any memory resource the
+// measures were allocated from must outlive the song
+struct Song {
 	std::int32_t major;
 	std::int32_t minor;
 	std::string title;
@@ -384,7 +899,6 @@ private:
 	std::string tab;
 	std::string instructions;
 	std::vector<std::string> comments;
-	std::int32_t lyricTrack;
 	Lyric lyric;
 	std::int32_t tempoValue;
 	std::int8_t globalKeySignature;
@@ -393,53 +907,301 @@ private:
 	std::int32_t trackCount;
 	std::vector<MeasureHeader> measureHeaders;
 	std::vector<Track> tracks;
+	NoteColumns noteColumns;
+
+	Song() = default;
+	Song(Song&&) = default;
+	Song& operator=(Song&&) = default;
+	Song(const Song&) = delete;
+	Song& operator=(const Song&) = delete;
+
+	std::string getXML(XmlProfile profile = XmlProfile::Full) const;
+	void writeXML(std::ostream& outputStream, XmlProfile profile = XmlProfile::Full) const;
+	void writeXML(const XmlSink& sink, XmlProfile profile = XmlProfile::Full) const;
+};
+
+template <class Tab>
+void writeTabXML(const Tab& tab, XmlWriter& writer);
+
+class Parser {
+	friend class StreamParser;
+	template <class Tab>
+	friend void writeTabXML(const Tab& tab, XmlWriter& writer);
+	friend TabMetadataView readMetadataView(const InputBuffer& buffer);
+public:
+	explicit Parser(const ParseOptions& options = ParseOptions()) : options(options) {}
+	Parser(const char *filePath, const ParseOptions& options = ParseOptions());
+	Parser(const std::byte *data, std::size_t size, const ParseOptions& options = ParseOptions());
+	Parser(std::vector<char>&& buffer, const ParseOptions& options = ParseOptions());
+	void parse(const char *filePath);
+	void parse(const std::byte *data, std::size_t size);
+	void parse(std::vector<char>&& buffer);
+	ParseResult tryParse(const char *filePath) noexcept;
+	ParseResult tryParse(const std::byte *data, std::size_t size) noexcept;
+	void reset();
+	std::string getXML(XmlProfile profile = XmlProfile::Full) const;
+	void writeXML(std::ostream& outputStream, XmlProfile profile = XmlProfile::Full) const;
+	void writeXML(const XmlSink& sink, XmlProfile profile = XmlProfile::Full) const;
+	TabFile getTabFile();
+	Song takeSong();
+	TabMetadata getMetadata() const;
+	const TabMetadataView& getMetadataView() const;
+	const NoteColumns& getNoteColumns() const;
+	MeasureIndex createMeasureIndex();
+	Measure decodeMeasure(const MeasureIndex& index, std::int32_t measureIndex, std::int32_t trackIndex);
+	Measure decodeMeasureFromTiedNoteState(const MeasureIndex& index, std::int32_t measureIndex, std::int32_t trackIndex);
+	TiedNoteState getTiedNoteState(std::int32_t trackIndex) const;
+	void setTiedNoteState(std::int32_t trackIndex, const TiedNoteState& state);
+private:
+	// Private member properties
+	ParseOptions options;
+	InputBuffer fileBuffer;
+	std::size_t bufferPosition = 0;
+	bool truncated = false;
+	ParsePhase phase = ParsePhase::Header;
+	std::int64_t phaseIndex = 0;
+	TimeSignature currentTimeSignature;
+	Tempo currentTempo;
+	std::int32_t currentStart = 0;
+	std::vector<TiedNoteState> tiedNoteStates;
+	NoteColumns noteColumns;
+	std::size_t measuresPosition = 0;
+	std::string_view version;
+	std::size_t versionIndex = 0;
+
+	// Measure decoders specialised for the version being read, chosen once
+	// the version is known so that measures need not check it again
+	void (Parser::*measureReader)(Measure&, Track&, Tempo&, TiedNoteState&, std::int8_t) = nullptr;
+	void (Parser::*measureSkipper)(Track&, Tempo&) = nullptr;
+	std::int32_t major = 0;
+	std::int32_t minor = 0;
+	std::string title;
+	std::string subtitle;
+	std::string artist;
+	std::string album;
+	std::string lyricsAuthor;
+	std::string musicAuthor;
+	std::string copyright;
+	std::string tab;
+	std::string instructions;
+	std::vector<std::string> comments;
+	std::int32_t lyricTrack = 0;
+	Lyric lyric = Lyric();
+	std::int32_t tempoValue = 0;
+	std::int8_t globalKeySignature = 0;
+	std::vector<Channel> channels;
+	std::int32_t measures = 0;
+	std::int32_t trackCount = 0;
+	std::vector<MeasureHeader> measureHeaders;
+	std::vector<Track> tracks;
+
+	// Tracks from previous tabs, kept so that the next tab can reuse the
+	// storage of their measures
+	std::vector<Track> spareTracks;
+
+	// Why the last parse failed, and whether a note was being read at the
+	// time, so that failures within measures can be narrowed down
+	ParseResult failure;
+	bool readingNote = false;
+
+	// Views of the descriptive text within the file buffer - when only
+	// these are wanted the text is not copied out at all
+	TabMetadataView metadataView;
+	bool copyText = true;
+
+	// Position of the beat lookup while the voices of a measure are read -
+	// the first 'shared' beats belong to the first voice and are in start
+	// order, and 'next' is the first of those not yet passed by the second
+	struct BeatCursor {
+		std::size_t shared = 0;
+		std::size_t next = 0;
+	};
+
+	// Reader over a fixed size record whose bytes have all been checked as
+	// available up front, so that its fields need no checks of their own
+	class RecordCursor {
+	public:
+		RecordCursor() = default;
+		explicit RecordCursor(const char *bytes) : bytes(bytes) {}
+
+		std::uint8_t readUnsignedByte() { return static_cast<std::uint8_t>(*bytes++); }
+		std::int8_t readByte() { return static_cast<std::int8_t>(*bytes++); }
+		std::int32_t readInt() { auto value = loadInt(bytes); bytes += 4; return value; }
+		const char *data() const { return bytes; }
+		void skip(std::size_t n) { bytes += n; }
+
+		/* This loads a little-endian 32-bit integer in a single load */
+		static std::int32_t loadInt(const char *bytes)
+		{
+			std::uint32_t value;
+			std::memcpy(&value, bytes, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			value = __builtin_bswap32(value);
+#endif
+			return static_cast<std::int32_t>(value);
+		}
+	private:
+		const char *bytes = nullptr;
+	};
+
+	// Private member functions for parsing the file buffer record by record
+	void parse();
+	bool parseAll();
+	bool parseAvailable(ParsePhase lastPhase = ParsePhase::Complete);
+	void fail(ParseErrorCode code);
+	void readHeader();
+	void readChannelsAndCounts();
+	void readNextMeasureHeader();
+	void readNextTrack();
+	void readNextMeasure();
+	void readMeasuresInParallel();
+	const MeasureIndexEntry& findIndexEntry(const MeasureIndex& index, std::int32_t measureIndex, std::int32_t trackIndex) const;
+	Measure decodeMeasure(const MeasureIndex& index, std::int32_t measureIndex, std::int32_t trackIndex,
+			      TiedNoteState tiedNotes);
 
 	// Private member functions for reading low-level file data
 	std::uint8_t readUnsignedByte();
 	std::int8_t readByte();
 	std::int32_t readInt();
-	std::string readString(std::size_t size);
-	std::string readString(std::size_t size, std::size_t len);
-	std::string readStringByte(std::size_t size);
-	std::string readStringByteSizeOfInteger();
-	std::string readStringInteger();
+	std::string_view readString(std::size_t size);
+	std::string_view readString(std::size_t size, std::size_t len);
+	std::string_view readStringByte(std::size_t size);
+	std::string_view readStringByteSizeOfInteger();
+	std::string_view readStringInteger();
+	void skipStringByte(std::size_t size);
+	void skipStringByteSizeOfInteger();
+	void skipStringInteger();
 	void skip(std::size_t n);
+	bool canRead(std::size_t n);
+	bool canReadRecords(std::int32_t count, std::size_t size);
+	bool readRecord(std::size_t size, RecordCursor& record);
 
 	// Private member functions for parsing higher-level file data
 	void readVersion();
-	bool isSupportedVersion(std::string& version);
+	bool isSupportedVersion(std::string_view version);
+	void selectDecoders();
 	Lyric readLyrics();
 	void readPageSetup();
 	std::int8_t readKeySignature();
-	std::vector<Channel> readChannels();
+	void readChannels(std::vector<Channel>& channels);
 	Color readColor();
 	void readChannel(Track& track);
-	void readMeasure(Measure& measure, Track& track, Tempo& tempo, std::int8_t keySignature);
-	std::int32_t getLength(MeasureHeader& header);
-	Beat& getBeat(Measure& measure, std::int32_t start);
+	template <std::size_t Version>
+	void readMeasure(Measure& measure, Track& track, Tempo& tempo, TiedNoteState& tiedNotes, std::int8_t keySignature);
+	bool addLength(std::int32_t& start, MeasureHeader& header);
+	bool addTime(std::int32_t& start, double time);
+	Beat& getBeat(Measure& measure, std::int32_t start, BeatCursor& cursor);
+	template <std::size_t Version>
 	void readMixChange(Tempo& tempo);
-	void readBeatEffects(Beat& beat, NoteEffect& noteEffect);
-	void readTremoloBar(NoteEffect& effect);
+	void readBeatEffects(Beat& beat, Measure& measure, NoteEffect& noteEffect);
+	void readTremoloBar(RareNoteEffects& effects);
 	void readText(Beat& beat);
 	void readChord(std::vector<GuitarString>& strings, Beat& beat);
 	double getTime(Duration duration);
 	double readDuration(std::uint8_t flags);
-	double readBeat(std::int32_t start, Measure& measure, Track& track, Tempo& tempo, std::size_t voiceIndex);
-	Note readNote(GuitarString& string, Track& track, NoteEffect& effect);
-	std::int8_t getTiedNoteValue(std::int32_t string, Track& track);
-	void readNoteEffects(NoteEffect& noteEffect);
-	void readBend(NoteEffect& effect);
-	void readGrace(NoteEffect& effect);
-	void readTremoloPicking(NoteEffect& effect);
-	void readArtificialHarmonic(NoteEffect& effect);
-	void readTrill(NoteEffect& effect);
+	template <std::size_t Version>
+	double readBeat(std::int32_t start, Measure& measure, Track& track, Tempo& tempo,
+			TiedNoteState& tiedNotes, std::size_t voiceIndex, BeatCursor& cursor);
+	Note readNote(GuitarString& string, Measure& measure, const TiedNoteState& tiedNotes, NoteEffect& effect);
+	std::int8_t getTiedNoteValue(std::int32_t string, const TiedNoteState& tiedNotes);
+	void resolveTiedNotes(Measure& measure, TiedNoteState& tiedNotes, const TiedNoteState& measureTiedNotes);
+	void readNoteEffects(Measure& measure, NoteEffect& noteEffect);
+	void readBend(RareNoteEffects& effects);
+	void readGrace(RareNoteEffects& effects);
+	void readTremoloPicking(RareNoteEffects& effects);
+	void readArtificialHarmonic(RareNoteEffects& effects);
+	void readTrill(RareNoteEffects& effects);
+	template <std::size_t Version>
+	void skipMeasure(Track& track, Tempo& tempo);
+	template <std::size_t Version>
+	void skipBeat(Track& track, Tempo& tempo);
+	void skipBeatEffects();
+	void skipNote();
+	void skipNoteEffects();
+	void skipPoints();
+	bool isTrackSelected(std::size_t index) const;
+	void addToNoteColumns(std::int32_t trackIndex, const Measure& measure);
+	std::pmr::memory_resource *memoryResource() const;
+	Track newTrack();
 	bool isPercussionChannel(std::int32_t channelId);
-	std::string getClef(Track& track);
+	Clef getClef(Track& track);
+};
+
+// Define stream parser class, which accepts a tab file in chunks as they arrive
+// and decodes each record as soon as all of its bytes are available. Only the
+// bytes of the record currently being read are held onto, and each measure is
+// reported through the measure callback in the options once decoded
+class StreamParser {
+public:
+	StreamParser(const ParseOptions& options = ParseOptions());
+	bool feed(const std::byte *data, std::size_t size);
+	void finish();
+	bool isComplete() const;
+	std::string getXML(XmlProfile profile = XmlProfile::Full) const;
+	void writeXML(std::ostream& outputStream, XmlProfile profile = XmlProfile::Full) const;
+	void writeXML(const XmlSink& sink, XmlProfile profile = XmlProfile::Full) const;
+	TabFile getTabFile();
+	Song takeSong();
+private:
+	Parser parser;
+	std::vector<char> window;
+};
+
+// Define batch options struct, which controls how a batch of tabs is parsed.
+// The parse options are used for every tab, so any measure callback in them
+// is called from several threads at once. No more than maxPendingResults tabs
+// (twice the thread count if left at 0) are held parsed or being parsed at
+// once before being handed back, so that a slow consumer cannot leave the
+// whole batch sitting in memory
+struct BatchOptions {
+	ParseOptions parseOptions;
+	std::size_t threadCount = 0;
+	bool inputOrder = false;
+	std::size_t maxPendingResults = 0;
+};
+
+// Define batch result struct, which holds the outcome for a single tab of a
+// batch - either the song or the reason it could not be parsed, along with
+// where in the file and in what part of it
+struct BatchResult {
+	std::size_t index = 0;
+	std::string path;
+	bool succeeded = false;
+	std::string error;
+	ParseResult parseResult;
+	Song song;
+};
+
+typedef std::function<void(BatchResult&& result)> BatchCallback;
+
+// Define batch parser class, which parses a list of tab files or buffers on a
+// pool of worker threads (one per core unless set in the options), handing
+// back each result in turn from next(). Results come back as soon as they are
+// ready, or in the order of the input when asked for. A tab which fails to
+// parse is reported in its result without stopping the rest of the batch
+class BatchParser {
+public:
+	BatchParser(const std::vector<std::string>& paths, const BatchOptions& options = BatchOptions());
+	BatchParser(const std::vector<std::vector<char>>& buffers, const BatchOptions& options = BatchOptions());
+	~BatchParser();
+	BatchParser(const BatchParser&) = delete;
+	BatchParser& operator=(const BatchParser&) = delete;
+	bool next(BatchResult& result);
+private:
+	// The jobs, the pending results and the workers, kept out of the header
+	// so that its includers need not pull in the threading headers
+	struct State;
+	std::unique_ptr<State> state;
 };
 
+void parseBatch(const std::vector<std::string>& paths, const BatchCallback& callback, const BatchOptions& options = BatchOptions());
+void parseBatch(const std::vector<std::vector<char>>& buffers, const BatchCallback& callback, const BatchOptions& options = BatchOptions());
+XmlSink fileSink(std::FILE *file);
+XmlSink descriptorSink(int fd);
+TabMetadata readMetadata(const char *filePath, InputBackend backend = InputBackend::MemoryMapped);
+TabMetadataView readMetadataView(const InputBuffer& buffer);
 std::int32_t numOfDigits(std::int32_t num);
 Duration denominatorToDuration(Denominator& denominator);
-void addSpacingToXML(std::ostringstream& outputStream, std::int32_t indentLevel);
 
 }
 
@@ -0,0 +1,131 @@
+/* Copyright Phillip Potter, 2019 under MIT License */
+#include <stdexcept>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include "gp_parser.h"
+
+namespace gp_parser {
+
+// Identifying bytes and format version at the start of a saved measure index
+static const char MEASURE_INDEX_MAGIC[] = { 'G', 'P', 'M', 'I' };
+static const std::uint32_t MEASURE_INDEX_VERSION = 1;
+
+// Sizes of the fixed size parts of a saved measure index
+static const std::size_t MEASURE_INDEX_HEADER_SIZE = 24;
+static const std::size_t MEASURE_INDEX_MEASURE_SIZE = 8;
+static const std::size_t MEASURE_INDEX_ENTRY_SIZE = 19;
+
+/* This appends an unsigned value to the byte vector in little-endian mode */
+static void writeBytes(std::vector<char>& bytes, std::uint64_t value, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+		bytes.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+/* This reads an unsigned value from the data in little-endian mode */
+static std::uint64_t readBytes(const char *data, std::size_t count)
+{
+	std::uint64_t value = 0;
+	for (std::size_t i = 0; i < count; ++i)
+		value |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data[i])) << (i * 8);
+
+	return value;
+}
+
+/* This converts the index to its saved form */
+std::vector<char> MeasureIndex::toBytes() const
+{
+	std::vector<char> bytes;
+	bytes.reserve(MEASURE_INDEX_HEADER_SIZE +
+		      measureStarts.size() * MEASURE_INDEX_MEASURE_SIZE +
+		      entries.size() * MEASURE_INDEX_ENTRY_SIZE);
+
+	for (auto c : MEASURE_INDEX_MAGIC)
+		bytes.push_back(c);
+	writeBytes(bytes, MEASURE_INDEX_VERSION, 4);
+	writeBytes(bytes, fileSize, 8);
+	writeBytes(bytes, static_cast<std::uint32_t>(measures), 4);
+	writeBytes(bytes, static_cast<std::uint32_t>(trackCount), 4);
+	for (std::size_t i = 0; i < measureStarts.size(); ++i) {
+		writeBytes(bytes, static_cast<std::uint32_t>(measureStarts[i]), 4);
+		writeBytes(bytes, static_cast<std::uint32_t>(measureTempos[i]), 4);
+	}
+	for (auto& entry : entries) {
+		writeBytes(bytes, entry.position, 8);
+		writeBytes(bytes, static_cast<std::uint32_t>(entry.tempo), 4);
+		for (auto fret : entry.tiedNotes.frets)
+			bytes.push_back(static_cast<char>(fret));
+	}
+
+	return bytes;
+}
+
+/* This creates an index from its saved form, checking that it is complete */
+MeasureIndex MeasureIndex::fromBytes(const char *data, std::size_t size)
+{
+	if (data == nullptr || size < MEASURE_INDEX_HEADER_SIZE ||
+	    !std::equal(std::begin(MEASURE_INDEX_MAGIC), std::end(MEASURE_INDEX_MAGIC), data) ||
+	    readBytes(data + 4, 4) != MEASURE_INDEX_VERSION)
+		throw std::logic_error("Invalid measure index");
+
+	auto index = MeasureIndex();
+	index.fileSize = readBytes(data + 8, 8);
+	index.measures = static_cast<std::int32_t>(readBytes(data + 16, 4));
+	index.trackCount = static_cast<std::int32_t>(readBytes(data + 20, 4));
+
+	// Tabs without tracks have no entries at all
+	std::size_t measureCount = index.measures > 0 && index.trackCount > 0 ? index.measures : 0;
+	std::size_t entryCount = measureCount * (index.trackCount > 0 ? index.trackCount : 0);
+	if (measureCount > size || entryCount / MEASURE_INDEX_ENTRY_SIZE > size ||
+	    size != MEASURE_INDEX_HEADER_SIZE +
+		    measureCount * MEASURE_INDEX_MEASURE_SIZE +
+		    entryCount * MEASURE_INDEX_ENTRY_SIZE)
+		throw std::logic_error("Invalid measure index");
+
+	auto position = data + MEASURE_INDEX_HEADER_SIZE;
+	index.measureStarts.resize(measureCount);
+	index.measureTempos.resize(measureCount);
+	for (std::size_t i = 0; i < measureCount; ++i) {
+		index.measureStarts[i] = static_cast<std::int32_t>(readBytes(position, 4));
+		index.measureTempos[i] = static_cast<std::int32_t>(readBytes(position + 4, 4));
+		position += MEASURE_INDEX_MEASURE_SIZE;
+	}
+	index.entries.resize(entryCount);
+	for (auto& entry : index.entries) {
+		entry.position = readBytes(position, 8);
+		entry.tempo = static_cast<std::int32_t>(readBytes(position + 8, 4));
+		for (auto i = 0; i < 7; ++i)
+			entry.tiedNotes.frets[i] = static_cast<std::int8_t>(position[12 + i]);
+		position += MEASURE_INDEX_ENTRY_SIZE;
+	}
+
+	return index;
+}
+
+/* This saves the index to the supplied file */
+void MeasureIndex::save(const char *filePath) const
+{
+	if (filePath == nullptr)
+		throw std::logic_error("Null file path passed to save");
+
+	auto bytes = toBytes();
+	std::ofstream file;
+	file.open(filePath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	file.write(bytes.data(), bytes.size());
+	if (!file)
+		throw std::logic_error("Unable to write measure index");
+}
+
+/* This loads an index previously saved to the supplied file */
+MeasureIndex MeasureIndex::load(const char *filePath)
+{
+	if (filePath == nullptr)
+		throw std::logic_error("Null file path passed to load");
+
+	auto buffer = InputBuffer(filePath, InputBackend::Buffered);
+
+	return fromBytes(buffer.data(), buffer.size());
+}
+
+}
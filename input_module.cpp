@@ -0,0 +1,191 @@
+/* Copyright Phillip Potter, 2019 under MIT License */
+#include <stdexcept>
+#include <fstream>
+#include <utility>
+#include "gp_parser.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GP_PARSER_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gp_parser {
+
+// Size of each read when the buffered backend is used on a stream of unknown length
+static const std::size_t READ_CHUNK_SIZE = 64 * 1024;
+
+/* This constructor loads the supplied file using the requested backend - if
+ * the file cannot be mapped (pipes, devices, empty files or platforms without
+ * mmap) then it falls back to buffered reads */
+InputBuffer::InputBuffer(const char *filePath, InputBackend backend)
+{
+	load(filePath, backend);
+}
+
+/* This constructor borrows the caller's bytes without copying them - they must
+ * outlive the buffer */
+InputBuffer::InputBuffer(const std::byte *data, std::size_t size)
+	: bytes(reinterpret_cast<const char *>(data)), length(size)
+{
+}
+
+/* This constructor takes ownership of the caller's bytes */
+InputBuffer::InputBuffer(std::vector<char>&& bytes)
+	: buffer(std::move(bytes))
+{
+	this->bytes = buffer.data();
+	length = buffer.size();
+}
+
+InputBuffer::InputBuffer(InputBuffer&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+InputBuffer& InputBuffer::operator=(InputBuffer&& other) noexcept
+{
+	if (this != &other) {
+		release();
+		// Moving the vector keeps its storage, so the data pointer stays valid
+		buffer = std::move(other.buffer);
+		mapping = other.mapping;
+		bytes = other.bytes;
+		length = other.length;
+		other.mapping = nullptr;
+		other.bytes = nullptr;
+		other.length = 0;
+	}
+
+	return *this;
+}
+
+InputBuffer::~InputBuffer()
+{
+	release();
+}
+
+/* This loads the supplied file in place of the current contents, as per the
+ * constructor - any bytes held already have their storage reused */
+void InputBuffer::load(const char *filePath, InputBackend backend)
+{
+	if (!tryLoad(filePath, backend))
+		throw std::logic_error("Unable to open file");
+}
+
+/* This loads the supplied file as per load, but returns false rather than
+ * throwing if the file cannot be opened */
+bool InputBuffer::tryLoad(const char *filePath, InputBackend backend)
+{
+	clear();
+	if (backend == InputBackend::MemoryMapped && map(filePath))
+		return true;
+
+	return read(filePath);
+}
+
+/* This borrows the caller's bytes in place of the current contents, as per
+ * the constructor */
+void InputBuffer::borrow(const std::byte *data, std::size_t size)
+{
+	clear();
+	bytes = reinterpret_cast<const char *>(data);
+	length = size;
+}
+
+/* This empties the buffer, keeping the capacity of the internal vector */
+void InputBuffer::clear()
+{
+	release();
+	buffer.clear();
+	bytes = nullptr;
+	length = 0;
+}
+
+/* This maps the file read-only into memory, returning false if the file is
+ * not something which can be mapped */
+bool InputBuffer::map(const char *filePath)
+{
+#ifdef GP_PARSER_HAVE_MMAP
+	auto fd = ::open(filePath, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	// Only regular files with some content can be mapped
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+		::close(fd);
+		return false;
+	}
+
+	auto address = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (address == MAP_FAILED)
+		return false;
+
+	// The parser walks the file front to back, so let the kernel read ahead
+	::madvise(address, info.st_size, MADV_SEQUENTIAL);
+
+	mapping = address;
+	bytes = static_cast<const char *>(address);
+	length = info.st_size;
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/* This reads the whole file into the internal vector, in large blocks rather
+ * than byte by byte - the size is reserved up front where the stream can tell
+ * us how long it is. False is returned if the file cannot be opened */
+bool InputBuffer::read(const char *filePath)
+{
+	std::ifstream file;
+	file.open(filePath, std::ifstream::in | std::ifstream::binary);
+	if (!file.is_open())
+		return false;
+
+	// Work out the initial buffer size
+	auto initialSize = READ_CHUNK_SIZE;
+	if (file.seekg(0, std::ifstream::end)) {
+		auto fileSize = file.tellg();
+		if (fileSize > 0)
+			initialSize = static_cast<std::size_t>(fileSize) + 1;
+	}
+	file.clear();
+	file.seekg(0, std::ifstream::beg);
+	file.clear();
+
+	// Read until end of file, growing the buffer as we go
+	std::size_t used = 0;
+	buffer.resize(initialSize);
+	for (;;) {
+		file.read(buffer.data() + used, buffer.size() - used);
+		used += file.gcount();
+		if (!file)
+			break;
+		if (used == buffer.size())
+			buffer.resize(buffer.size() * 2);
+	}
+	buffer.resize(used);
+
+	bytes = buffer.data();
+	length = used;
+
+	return true;
+}
+
+/* This releases any mapping held by the buffer */
+void InputBuffer::release()
+{
+#ifdef GP_PARSER_HAVE_MMAP
+	if (mapping != nullptr)
+		::munmap(mapping, length);
+#endif
+	mapping = nullptr;
+}
+
+}
@@ -0,0 +1,86 @@
+/* Copyright Phillip Potter, 2019 under MIT License */
+#include <stdexcept>
+#include "gp_parser.h"
+
+namespace gp_parser {
+
+/* This constructor sets up an empty stream parser, ready to be fed */
+StreamParser::StreamParser(const ParseOptions& options)
+	: parser(options)
+{
+}
+
+/* This appends the next chunk of the tab file and decodes every record it
+ * completes, returning true once the whole tab has been read */
+bool StreamParser::feed(const std::byte *data, std::size_t size)
+{
+	if (data == nullptr && size > 0)
+		throw std::logic_error("Null data passed to stream parser");
+
+	// Drop the bytes which have already been decoded, keeping only the
+	// partial record at the end of the window
+	window.erase(window.begin(), window.begin() + parser.bufferPosition);
+	parser.bufferPosition = 0;
+
+	// Append the new chunk and point the parser at the window again, as
+	// it may have moved
+	auto bytes = reinterpret_cast<const char *>(data);
+	window.insert(window.end(), bytes, bytes + size);
+	parser.fileBuffer = InputBuffer(reinterpret_cast<const std::byte *>(window.data()), window.size());
+
+	// Running out of bytes only means waiting for the next chunk
+	if (parser.parseAvailable())
+		return true;
+	if (parser.failure.code != ParseErrorCode::Truncated)
+		throw std::logic_error(getName(parser.failure.code));
+
+	return false;
+}
+
+/* This signals that the whole tab file has been fed in, throwing if it ended
+ * part way through */
+void StreamParser::finish()
+{
+	if (!isComplete())
+		throw std::logic_error("Truncated file");
+}
+
+/* This tells us whether the whole tab has been read */
+bool StreamParser::isComplete() const
+{
+	return parser.phase == ParsePhase::Complete;
+}
+
+/* This returns the XML for the tab, as per the parser class */
+std::string StreamParser::getXML(XmlProfile profile) const
+{
+	return parser.getXML(profile);
+}
+
+/* This writes the XML for the tab to the supplied stream, as per the parser
+ * class */
+void StreamParser::writeXML(std::ostream& outputStream, XmlProfile profile) const
+{
+	parser.writeXML(outputStream, profile);
+}
+
+/* This writes the XML for the tab to the supplied sink, as per the parser
+ * class */
+void StreamParser::writeXML(const XmlSink& sink, XmlProfile profile) const
+{
+	parser.writeXML(sink, profile);
+}
+
+/* This returns the object form of the tab, as per the parser class */
+TabFile StreamParser::getTabFile()
+{
+	return parser.getTabFile();
+}
+
+/* This moves the decoded tab out, as per the parser class */
+Song StreamParser::takeSong()
+{
+	return parser.takeSong();
+}
+
+}
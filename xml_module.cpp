@@ -1,589 +1,698 @@
 /* Copyright Phillip Potter, 2019 under MIT License */
 #include <string>
-#include <sstream>
+#include <array>
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <cerrno>
 #include "gp_parser.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define GP_PARSER_HAVE_WRITE
+#include <unistd.h>
+#endif
+
 namespace gp_parser {
 
-template <class T>
-void addObjectsToXML(const std::string& name, const std::vector<T>& objects, std::ostringstream& outputStream, std::int32_t indentLevel)
+// Indentation for the first few levels, so that a whole indent can be copied
+// at once - deeper levels fall back to a level at a time
+static constexpr std::size_t XML_SPACING_SIZE = sizeof(XML_SPACING) - 1;
+static constexpr std::size_t XML_INDENT_LEVELS = 16;
+static constexpr auto XML_INDENT = [] {
+	std::array<char, XML_SPACING_SIZE * XML_INDENT_LEVELS> indent{};
+	for (std::size_t i = 0; i < indent.size(); ++i)
+		indent[i] = XML_SPACING[i % XML_SPACING_SIZE];
+	return indent;
+}();
+
+template <class T, class Allocator, class... Context>
+void addObjectsToXML(std::string_view name, const std::vector<T, Allocator>& objects, XmlWriter& writer, std::int32_t indentLevel, const Context&... context)
 {
   if (objects.size() > 0) {
-    addSpacingToXML(outputStream, indentLevel);
-    outputStream << "<" << name << ">\n";
-    for (auto i = 0; i < objects.size(); ++i)
-      objects[i].addToXML(outputStream, indentLevel + 1);
-    addSpacingToXML(outputStream, indentLevel);
-    outputStream << "</" << name << ">\n";
+    writer.line(indentLevel, "<");
+    writer.append(name);
+    writer.append(">\n");
+    for (auto i = 0; i < objects.size(); ++i) {
+      writer.keepNextTag();
+      objects[i].addToXML(writer, indentLevel + 1, context...);
+    }
+    writer.line(indentLevel, "</");
+    writer.append(name);
+    writer.append(">\n");
   }
 }
 
-/* Calling this will provide a std::string which has the XML representing the
- * tab file used to construct the parser object */
-std::string Parser::getXML() const
+/* This writes the XML representing a whole tab, which may be either a
+ * parser or a song taken from one */
+template <class Tab>
+void writeTabXML(const Tab& tab, XmlWriter& writer)
 {
-	// Declare output stream
-	std::ostringstream outputStream;
-
-	// Output XML declaration to stream
-	outputStream << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n";
+	// Output XML declaration
+	writer.append("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n");
 
 	// Output opening tag
-	outputStream << "<TabFile>\n";
+	writer.append("<TabFile>\n");
 
 	// Begin outputting state
-	outputStream << XML_SPACING << "<Version>\n";
-	outputStream << XML_SPACING << XML_SPACING << "<Major>" << major << "</Major>\n";
-	outputStream << XML_SPACING << XML_SPACING << "<Minor>" << minor << "</Minor>\n";
-	outputStream << XML_SPACING << "</Version>\n";
-	outputStream << XML_SPACING << "<Title>" << title << "</Title>\n";
-	outputStream << XML_SPACING << "<Subtitle>" << subtitle << "</Subtitle>\n";
-	outputStream << XML_SPACING << "<Artist>" << artist << "</Artist>\n";
-	outputStream << XML_SPACING << "<Album>" << album << "</Album>\n";
-	outputStream << XML_SPACING << "<LyricsAuthor>" << lyricsAuthor << "</LyricsAuthor>\n";
-	outputStream << XML_SPACING << "<MusicAuthor>" << musicAuthor << "</MusicAuthor>\n";
-	outputStream << XML_SPACING << "<Copyright>" << copyright << "</Copyright>\n";
-	outputStream << XML_SPACING << "<Tab>" << tab << "</Tab>\n";
-	outputStream << XML_SPACING << "<Instructions>" << instructions << "</Instructions>\n";
+	writer.openTag(1, "<Version>\n");
+	writer.element(2, "<Major>", tab.major, "</Major>\n");
+	writer.element(2, "<Minor>", tab.minor, "</Minor>\n");
+	writer.closeTag(1, "</Version>\n");
+	writer.element(1, "<Title>", tab.title, "</Title>\n");
+	writer.element(1, "<Subtitle>", tab.subtitle, "</Subtitle>\n");
+	writer.element(1, "<Artist>", tab.artist, "</Artist>\n");
+	writer.element(1, "<Album>", tab.album, "</Album>\n");
+	writer.element(1, "<LyricsAuthor>", tab.lyricsAuthor, "</LyricsAuthor>\n");
+	writer.element(1, "<MusicAuthor>", tab.musicAuthor, "</MusicAuthor>\n");
+	writer.element(1, "<Copyright>", tab.copyright, "</Copyright>\n");
+	writer.element(1, "<Tab>", tab.tab, "</Tab>\n");
+	writer.element(1, "<Instructions>", tab.instructions, "</Instructions>\n");
 
 	// Output comments
-	if (comments.size() > 0) {
-		outputStream << XML_SPACING << "<Comments>\n";
-		for (auto i = 0; i < comments.size(); ++i) {
-			outputStream << XML_SPACING << XML_SPACING;
-			outputStream << "<Comment>" << comments[i] << "</Comment>\n";
-		}
-		outputStream << XML_SPACING << "</Comments>\n";
+	if (tab.comments.size() > 0) {
+		writer.line(1, "<Comments>\n");
+		for (auto i = 0; i < tab.comments.size(); ++i)
+			writer.item(2, "<Comment>", tab.comments[i], "</Comment>\n");
+		writer.line(1, "</Comments>\n");
 	}
 
 	// Output lyric
-	lyric.addToXML(outputStream, 1);
+	tab.lyric.addToXML(writer, 1);
 
 	// Output tempo value
-	outputStream << XML_SPACING << "<TempoValue>" << tempoValue << "</TempoValue>\n";
+	writer.element(1, "<TempoValue>", tab.tempoValue, "</TempoValue>\n");
 
 	// Output key signature
-	outputStream << XML_SPACING << "<KeySignature>" << static_cast<std::int32_t>(globalKeySignature) << "</KeySignature>\n";
+	writer.element(1, "<KeySignature>", tab.globalKeySignature, "</KeySignature>\n");
 
 	// Output channels
-	addObjectsToXML("Channels", channels, outputStream, 1);
+	addObjectsToXML("Channels", tab.channels, writer, 1);
 
 	// Output measures
-	outputStream << XML_SPACING << "<Measures>" << measures << "</Measures>\n";
+	writer.element(1, "<Measures>", tab.measures, "</Measures>\n");
 
 	// Output track count
-	outputStream << XML_SPACING << "<TrackCount>" << trackCount << "</TrackCount>\n";
+	writer.element(1, "<TrackCount>", tab.trackCount, "</TrackCount>\n");
 
 	// Output measure headers
-	addObjectsToXML("MeasureHeaders", measureHeaders, outputStream, 1);
+	addObjectsToXML("MeasureHeaders", tab.measureHeaders, writer, 1);
 
 	// Output tracks
-    addObjectsToXML("Tracks", tracks, outputStream, 1);
+    addObjectsToXML("Tracks", tab.tracks, writer, 1);
 
 	// Output closing tag
-	outputStream << "</TabFile>\n";
+	writer.append("</TabFile>\n");
+}
+
+/* This builds the XML for a whole tab in a single string - formatting is
+ * cheap next to growing a string of many megabytes, so the XML is measured
+ * first and then written into a string of exactly the right size */
+template <class Tab>
+static std::string getTabXML(const Tab& tab, XmlProfile profile)
+{
+	std::size_t size = 0;
+	XmlSink measure = [&size](const char *, std::size_t chunkSize) {
+		size += chunkSize;
+	};
+	XmlWriter measureWriter(measure, profile);
+	writeTabXML(tab, measureWriter);
+	measureWriter.flush();
+
+	std::string output;
+	output.reserve(size);
+	XmlWriter writer(output, profile);
+	writeTabXML(tab, writer);
+	writer.flush();
+
+	return output;
+}
+
+/* This writes the XML for a whole tab to the buffer of the supplied stream,
+ * a chunk at a time, setting badbit on the stream if it cannot all be
+ * written */
+template <class Tab>
+static void writeTabXMLTo(const Tab& tab, std::ostream& outputStream, XmlProfile profile)
+{
+	auto streamBuffer = outputStream.rdbuf();
+	auto failed = streamBuffer == nullptr;
+	if (!failed) {
+		XmlSink sink = [&](const char *data, std::size_t size) {
+			if (!failed && streamBuffer->sputn(data, size) != static_cast<std::streamsize>(size))
+				failed = true;
+		};
+		XmlWriter writer(sink, profile);
+		writeTabXML(tab, writer);
+		writer.flush();
+		if (!failed && streamBuffer->pubsync() == -1)
+			failed = true;
+	}
+	if (failed)
+		outputStream.setstate(std::ios_base::badbit);
+}
+
+/* This writes the XML for a whole tab to the supplied sink, a buffer at a
+ * time */
+template <class Tab>
+static void writeTabXMLTo(const Tab& tab, const XmlSink& sink, XmlProfile profile)
+{
+	XmlWriter writer(sink, profile);
+	writeTabXML(tab, writer);
+	writer.flush();
+}
+
+/* Calling this will provide a std::string which has the XML representing the
+ * tab file used to construct the parser object */
+std::string Parser::getXML(XmlProfile profile) const
+{
+	return getTabXML(*this, profile);
+}
+
+/* This writes the same XML as getXML to the supplied stream as it goes,
+ * rather than building it all in memory first */
+void Parser::writeXML(std::ostream& outputStream, XmlProfile profile) const
+{
+	writeTabXMLTo(*this, outputStream, profile);
+}
+
+/* This writes the same XML as getXML to the supplied sink as it goes */
+void Parser::writeXML(const XmlSink& sink, XmlProfile profile) const
+{
+	writeTabXMLTo(*this, sink, profile);
+}
+
+/* This provides the same XML as the parser the song was taken from */
+std::string Song::getXML(XmlProfile profile) const
+{
+	return getTabXML(*this, profile);
+}
+
+/* This writes the XML to the supplied stream, as per the parser class */
+void Song::writeXML(std::ostream& outputStream, XmlProfile profile) const
+{
+	writeTabXMLTo(*this, outputStream, profile);
+}
 
-	return outputStream.str();
+/* This writes the XML to the supplied sink, as per the parser class */
+void Song::writeXML(const XmlSink& sink, XmlProfile profile) const
+{
+	writeTabXMLTo(*this, sink, profile);
 }
 
-/* This function allows us to add an arbitrary number of indents to our XML stream */
-void addSpacingToXML(std::ostringstream& outputStream, std::int32_t indentLevel)
+/* This provides a sink which writes to the supplied C file */
+XmlSink fileSink(std::FILE *file)
 {
-	for (auto i = 0; i < indentLevel; ++i)
-		outputStream << XML_SPACING;
+	if (file == nullptr)
+		throw std::logic_error("Null file passed to file sink");
+
+	return [file](const char *data, std::size_t size) {
+		if (std::fwrite(data, 1, size, file) != size)
+			throw std::logic_error("Unable to write XML");
+	};
+}
+
+/* This provides a sink which writes to the supplied file descriptor, such
+ * as a pipe or socket */
+XmlSink descriptorSink(int fd)
+{
+#ifdef GP_PARSER_HAVE_WRITE
+	return [fd](const char *data, std::size_t size) {
+		while (size > 0) {
+			auto written = ::write(fd, data, size);
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written <= 0)
+				throw std::logic_error("Unable to write XML");
+			data += written;
+			size -= written;
+		}
+	};
+#else
+	throw std::logic_error("File descriptors are not supported on this platform");
+#endif
+}
+
+// Smallest buffer an XML writer will use, leaving room for any number
+static const std::size_t XML_WRITER_MIN_BUFFER_SIZE = 64;
+
+/* This constructor sets up a writer which appends to the supplied string */
+XmlWriter::XmlWriter(std::string& output, XmlProfile profile, std::size_t bufferSize)
+	: output(&output), profile(profile), buffer(std::max(bufferSize, XML_WRITER_MIN_BUFFER_SIZE))
+{
+	position = buffer.data();
+	end = buffer.data() + buffer.size();
+}
+
+/* This constructor sets up a writer which passes its output to the supplied
+ * sink, which must outlive it, a buffer at a time */
+XmlWriter::XmlWriter(const XmlSink& sink, XmlProfile profile, std::size_t bufferSize)
+	: sink(&sink), profile(profile), buffer(std::max(bufferSize, XML_WRITER_MIN_BUFFER_SIZE))
+{
+	position = buffer.data();
+	end = buffer.data() + buffer.size();
+}
+
+/* This passes whatever is buffered on to the string or sink - the buffer is
+ * emptied first, so that a sink which throws is not handed the same bytes
+ * again */
+void XmlWriter::flush()
+{
+	auto size = static_cast<std::size_t>(position - buffer.data());
+	position = buffer.data();
+	if (size == 0)
+		return;
+
+	if (output != nullptr)
+		output->append(buffer.data(), size);
+	else
+		(*sink)(buffer.data(), size);
+}
+
+/* This makes room in the buffer for the given number of bytes, which must be
+ * no more than the size of the buffer */
+void XmlWriter::makeRoom(std::size_t size)
+{
+	if (size > static_cast<std::size_t>(end - position))
+		flush();
+}
+
+/* This appends text which does not fit in what is left of the buffer - text
+ * larger than the whole buffer is passed on directly */
+void XmlWriter::appendLarge(std::string_view text)
+{
+	flush();
+	if (text.size() <= buffer.size()) {
+		std::memcpy(position, text.data(), text.size());
+		position += text.size();
+	} else if (output != nullptr) {
+		output->append(text.data(), text.size());
+	} else {
+		(*sink)(text.data(), text.size());
+	}
+}
+
+/* This starts a new line at the given indent - compact XML has none */
+void XmlWriter::indent(std::int32_t indentLevel)
+{
+	if (omitsDefaults())
+		return;
+
+	auto size = static_cast<std::size_t>(indentLevel > 0 ? indentLevel : 0) * XML_SPACING_SIZE;
+	if (size <= XML_INDENT.size())
+		append(std::string_view(XML_INDENT.data(), size));
+	else
+		for (auto i = 0; i < indentLevel; ++i)
+			append(XML_SPACING);
+}
+
+/* This writes the opening tags which have been held back, now that something
+ * is being written inside them */
+void XmlWriter::writePendingTags()
+{
+	for (auto& tag : pendingTags) {
+		indent(tag.first);
+		append(tag.second);
+	}
+	pendingTags.clear();
+}
+
+void XmlWriter::append(std::int32_t value)
+{
+	makeRoom(16);
+	position = std::to_chars(position, end, value).ptr;
+}
+
+void XmlWriter::append(std::uint32_t value)
+{
+	makeRoom(16);
+	position = std::to_chars(position, end, value).ptr;
+}
+
+/* Doubles are written with six significant figures, as a stream would by
+ * default */
+void XmlWriter::append(double value)
+{
+	makeRoom(32);
+	position = std::to_chars(position, end, value, std::chars_format::general, 6).ptr;
 }
 
 /* Below are all the struct-specific addToXML() functions */
 
-void Lyric::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Lyric::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<LyricInfo>\n";
+	writer.openTag(indentLevel, "<LyricInfo>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<From>" << from << "</From>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Lyric>" << lyric << "</Lyric>\n";
+	writer.element(indentLevel + 1, "<From>", from, "</From>\n");
+	writer.element(indentLevel + 1, "<Lyric>", lyric, "</Lyric>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</LyricInfo>\n";
+	writer.closeTag(indentLevel, "</LyricInfo>\n");
 }
 
-void Channel::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Channel::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Channel>\n";
+	writer.openTag(indentLevel, "<Channel>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Id>" << id << "</Id>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Name>" << name << "</Name>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Program>" << program << "</Program>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Volume>" << static_cast<std::int32_t>(volume) << "</Volume>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Balance>" << static_cast<std::int32_t>(balance) << "</Balance>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Chorus>" << static_cast<std::int32_t>(chorus) << "</Chorus>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Reverb>" << static_cast<std::int32_t>(reverb) << "</Reverb>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Phaser>" << static_cast<std::int32_t>(phaser) << "</Phaser>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Tremolo>" << static_cast<std::int32_t>(tremolo) << "</Tremolo>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Bank>" << bank << "</Bank>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<IsPercussionChannel>" << (isPercussionChannel ? "true" : "false")
-		     << "</IsPercussionChannel>\n";
-	addObjectsToXML("ChannelParameters", parameters, outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Id>", id, "</Id>\n");
+	writer.element(indentLevel + 1, "<Name>", name, "</Name>\n");
+	writer.element(indentLevel + 1, "<Program>", program, "</Program>\n");
+	writer.element(indentLevel + 1, "<Volume>", volume, "</Volume>\n");
+	writer.element(indentLevel + 1, "<Balance>", balance, "</Balance>\n");
+	writer.element(indentLevel + 1, "<Chorus>", chorus, "</Chorus>\n");
+	writer.element(indentLevel + 1, "<Reverb>", reverb, "</Reverb>\n");
+	writer.element(indentLevel + 1, "<Phaser>", phaser, "</Phaser>\n");
+	writer.element(indentLevel + 1, "<Tremolo>", tremolo, "</Tremolo>\n");
+	writer.element(indentLevel + 1, "<Bank>", bank, "</Bank>\n");
+	writer.element(indentLevel + 1, "<IsPercussionChannel>", isPercussionChannel, "</IsPercussionChannel>\n");
+	addObjectsToXML("ChannelParameters", parameters, writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Channel>\n";
+	writer.closeTag(indentLevel, "</Channel>\n");
 }
 
-void ChannelParam::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void ChannelParam::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<ChannelParam>\n";
+	writer.openTag(indentLevel, "<ChannelParam>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Key>" << key << "</Key>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Value>" << value << "</Value>\n";
+	writer.element(indentLevel + 1, "<Key>", key, "</Key>\n");
+	writer.element(indentLevel + 1, "<Value>", value, "</Value>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</ChannelParam>\n";
+	writer.closeTag(indentLevel, "</ChannelParam>\n");
 }
 
-void MeasureHeader::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void MeasureHeader::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<MeasureHeader>\n";
+	writer.openTag(indentLevel, "<MeasureHeader>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Number>" << number << "</Number>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Start>" << start << "</Start>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<RepeatOpen>" << (repeatOpen ? "true" : "false") << "</RepeatOpen>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<RepeatClose>" << static_cast<std::int32_t>(repeatClose) << "</RepeatClose>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<RepeatAlternative>" << static_cast<std::uint32_t>(repeatAlternative) << "</RepeatAlternative>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<TripletFeel>" << tripletFeel << "</TripletFeel>\n";
-	tempo.addToXML(outputStream, indentLevel + 1);
-	timeSignature.addToXML(outputStream, indentLevel + 1);
-	marker.addToXML(outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Number>", number, "</Number>\n");
+	writer.element(indentLevel + 1, "<Start>", start, "</Start>\n");
+	writer.element(indentLevel + 1, "<RepeatOpen>", repeatOpen, "</RepeatOpen>\n");
+	writer.element(indentLevel + 1, "<RepeatClose>", repeatClose, "</RepeatClose>\n");
+	writer.element(indentLevel + 1, "<RepeatAlternative>", repeatAlternative, "</RepeatAlternative>\n");
+	writer.element(indentLevel + 1, "<TripletFeel>", tripletFeel, "</TripletFeel>\n");
+	tempo.addToXML(writer, indentLevel + 1);
+	timeSignature.addToXML(writer, indentLevel + 1);
+	marker.addToXML(writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</MeasureHeader>\n";
+	writer.closeTag(indentLevel, "</MeasureHeader>\n");
 }
 
-void Tempo::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Tempo::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Tempo>\n";
+	writer.openTag(indentLevel, "<Tempo>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Value>" << value << "</Value>\n";
+	writer.element(indentLevel + 1, "<Value>", value, "</Value>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Tempo>\n";
+	writer.closeTag(indentLevel, "</Tempo>\n");
 }
 
-void TimeSignature::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void TimeSignature::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<TimeSignature>\n";
+	writer.openTag(indentLevel, "<TimeSignature>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Numerator>" << static_cast<std::int32_t>(numerator) << "</Numerator>\n";
-	denominator.addToXML(outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Numerator>", numerator, "</Numerator>\n");
+	denominator.addToXML(writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</TimeSignature>\n";
+	writer.closeTag(indentLevel, "</TimeSignature>\n");
 }
 
-void Denominator::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Denominator::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Denominator>\n";
+	writer.openTag(indentLevel, "<Denominator>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Value>" << static_cast<std::int32_t>(value) << "</Value>\n";
-	division.addToXML(outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Value>", value, "</Value>\n");
+	division.addToXML(writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Denominator>\n";
+	writer.closeTag(indentLevel, "</Denominator>\n");
 }
 
-void Division::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Division::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Division>\n";
+	writer.openTag(indentLevel, "<Division>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Enters>" << enters << "</Enters>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Times>" << times << "</Times>\n";
+	writer.element(indentLevel + 1, "<Enters>", enters, "</Enters>\n");
+	writer.element(indentLevel + 1, "<Times>", times, "</Times>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Division>\n";
+	writer.closeTag(indentLevel, "</Division>\n");
 }
 
-void Marker::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Marker::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Marker>\n";
+	writer.openTag(indentLevel, "<Marker>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Measure>" << measure << "</Measure>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Title>" << title << "</Title>\n";
-	color.addToXML(outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Measure>", measure, "</Measure>\n");
+	writer.element(indentLevel + 1, "<Title>", title, "</Title>\n");
+	color.addToXML(writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Marker>\n";
+	writer.closeTag(indentLevel, "</Marker>\n");
 }
 
-void Color::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Color::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Color>\n";
+	writer.openTag(indentLevel, "<Color>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Red>" << static_cast<uint32_t>(r) << "</Red>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Green>" << static_cast<uint32_t>(g) << "</Green>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Blue>" << static_cast<uint32_t>(b) << "</Blue>\n";
+	writer.element(indentLevel + 1, "<Red>", r, "</Red>\n");
+	writer.element(indentLevel + 1, "<Green>", g, "</Green>\n");
+	writer.element(indentLevel + 1, "<Blue>", b, "</Blue>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Color>\n";
+	writer.closeTag(indentLevel, "</Color>\n");
 }
 
-void Track::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Track::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Track>\n";
+	writer.openTag(indentLevel, "<Track>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<ChannelId>" << channelId << "</ChannelId>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Number>" << number << "</Number>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Name>" << name << "</Name>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Offset>" << offset << "</Offset>\n";
-	lyrics.addToXML(outputStream, indentLevel + 1);
-	color.addToXML(outputStream, indentLevel + 1);
-	addObjectsToXML("Strings", strings, outputStream, indentLevel + 1);
-	addObjectsToXML("Measures", measures, outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<ChannelId>", channelId, "</ChannelId>\n");
+	writer.element(indentLevel + 1, "<Number>", number, "</Number>\n");
+	writer.element(indentLevel + 1, "<Name>", name, "</Name>\n");
+	writer.element(indentLevel + 1, "<Offset>", offset, "</Offset>\n");
+	lyrics.addToXML(writer, indentLevel + 1);
+	color.addToXML(writer, indentLevel + 1);
+	addObjectsToXML("Strings", strings, writer, indentLevel + 1);
+	addObjectsToXML("Measures", measures, writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Track>\n";
+	writer.closeTag(indentLevel, "</Track>\n");
 }
 
-void GuitarString::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void GuitarString::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<String>\n";
+	writer.openTag(indentLevel, "<String>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Number>" << number << "</Number>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Value>" << value << "</Value>\n";
+	writer.element(indentLevel + 1, "<Number>", number, "</Number>\n");
+	writer.element(indentLevel + 1, "<Value>", value, "</Value>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</String>\n";
+	writer.closeTag(indentLevel, "</String>\n");
 }
 
-void Measure::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Measure::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Measure>\n";
+	writer.openTag(indentLevel, "<Measure>\n");
 
-	header->addToXML(outputStream, indentLevel + 1);
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Start>" << start << "</Start>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<KeySignature>" << static_cast<std::int32_t>(keySignature) << "</KeySignature>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Clef>" << clef << "</Clef>\n";
-    addObjectsToXML("Beats", beats, outputStream, indentLevel + 1);
+	if (writer.normalizes())
+		writer.item(indentLevel + 1, "<Header>", header->number, "</Header>\n");
+	else
+		header->addToXML(writer, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Start>", start, "</Start>\n");
+	writer.element(indentLevel + 1, "<KeySignature>", keySignature, "</KeySignature>\n");
+	writer.element(indentLevel + 1, "<Clef>", clef, "</Clef>\n");
+    addObjectsToXML("Beats", beats, writer, indentLevel + 1, *this);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Measure>\n";
+	writer.closeTag(indentLevel, "</Measure>\n");
 }
 
-void Beat::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Beat::addToXML(XmlWriter& writer, std::int32_t indentLevel, const Measure& measure) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Beat>\n";
+	writer.openTag(indentLevel, "<Beat>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Start>" << start << "</Start>\n";
-	text.addToXML(outputStream, indentLevel + 1);
-	stroke.addToXML(outputStream, indentLevel + 1);
-	chord.addToXML(outputStream, indentLevel + 1);
-	addObjectsToXML("Voices", voices, outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Start>", start, "</Start>\n");
+	text.addToXML(writer, indentLevel + 1);
+	stroke.addToXML(writer, indentLevel + 1);
+	chord.addToXML(writer, indentLevel + 1);
+	addObjectsToXML("Voices", voices, writer, indentLevel + 1, measure);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Beat>\n";
+	writer.closeTag(indentLevel, "</Beat>\n");
 }
 
-void BeatText::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void BeatText::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<BeatText>\n";
+	writer.openTag(indentLevel, "<BeatText>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Value>" << value << "</Value>\n";
+	writer.element(indentLevel + 1, "<Value>", value, "</Value>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</BeatText>\n";
+	writer.closeTag(indentLevel, "</BeatText>\n");
 }
 
-void Stroke::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Stroke::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Stroke>\n";
+	writer.openTag(indentLevel, "<Stroke>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Direction>" << direction << "</Direction>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Value>" << value << "</Value>\n";
+	writer.element(indentLevel + 1, "<Direction>", direction, "</Direction>\n");
+	writer.element(indentLevel + 1, "<Value>", value, "</Value>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Stroke>\n";
+	writer.closeTag(indentLevel, "</Stroke>\n");
 }
 
-void Chord::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Chord::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Chord>\n";
+	writer.openTag(indentLevel, "<Chord>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Name>" << name << "</Name>\n";
-	if (strings != nullptr) {
-      addObjectsToXML("Strings", *strings, outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Name>", name, "</Name>\n");
+	if (strings != nullptr && !writer.normalizes()) {
+      addObjectsToXML("Strings", *strings, writer, indentLevel + 1);
     }
 	if (frets.size() > 0) {
-		addSpacingToXML(outputStream, indentLevel + 1);
-		outputStream << "<Frets>\n";
+		writer.line(indentLevel + 1, "<Frets>\n");
 		for (auto i = 0; i < frets.size(); ++i) {
-			addSpacingToXML(outputStream, indentLevel + 2);
-			outputStream << "<Fret>" << frets[i] << "</Fret>\n";
+			writer.item(indentLevel + 2, "<Fret>", frets[i], "</Fret>\n");
 		}
-		addSpacingToXML(outputStream, indentLevel + 1);
-		outputStream << "</Frets>\n";
+		writer.line(indentLevel + 1, "</Frets>\n");
 	}
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Chord>\n";
+	writer.closeTag(indentLevel, "</Chord>\n");
 }
 
-void Voice::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Voice::addToXML(XmlWriter& writer, std::int32_t indentLevel, const Measure& measure) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Voice>\n";
+	writer.openTag(indentLevel, "<Voice>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Empty>" << (empty ? "true" : "false") << "</Empty>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Duration>" << duration << "</Duration>\n";
-	addObjectsToXML("Notes", notes, outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Empty>", empty, "</Empty>\n");
+	writer.element(indentLevel + 1, "<Duration>", duration, "</Duration>\n");
+	addObjectsToXML("Notes", notes, writer, indentLevel + 1, measure);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Voice>\n";
+	writer.closeTag(indentLevel, "</Voice>\n");
 }
 
-void Note::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Note::addToXML(XmlWriter& writer, std::int32_t indentLevel, const Measure& measure) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Note>\n";
+	writer.openTag(indentLevel, "<Note>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<String>" << string << "</String>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<TiedNote>" << (tiedNote ? "true" : "false") << "</TiedNote>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Value>" << static_cast<std::int32_t>(value) << "</Value>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Velocity>" << velocity << "</Velocity>\n";
-	effect.addToXML(outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<String>", string, "</String>\n");
+	writer.element(indentLevel + 1, "<TiedNote>", tiedNote, "</TiedNote>\n");
+	writer.element(indentLevel + 1, "<Value>", value, "</Value>\n");
+	writer.element(indentLevel + 1, "<Velocity>", velocity, "</Velocity>\n");
+	effect.addToXML(writer, indentLevel + 1, measure);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Note>\n";
+	writer.closeTag(indentLevel, "</Note>\n");
 }
 
-void NoteEffect::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void NoteEffect::addToXML(XmlWriter& writer, std::int32_t indentLevel, const Measure& measure) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Effect>\n";
+	// Most notes have no effects at all, which compact XML leaves out
+	if (writer.omitsDefaults() && flags == 0 && rareEffects == NO_RARE_NOTE_EFFECTS)
+		return;
+
+	writer.openTag(indentLevel, "<Effect>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<FadeIn>" << (fadeIn ? "true" : "false") << "</FadeIn>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Vibrato>" << (vibrato ? "true" : "false") << "</Vibrato>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Tapping>" << (tapping ? "true" : "false") << "</Tapping>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Slapping>" << (slapping ? "true" : "false") << "</Slapping>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Popping>" << (popping ? "true" : "false") << "</Popping>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<DeadNote>" << (deadNote ? "true" : "false") << "</DeadNote>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<AccentuatedNote>" << (accentuatedNote ? "true" : "false") << "</AccentuatedNote>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<HeavyAccentuatedNote>" << (heavyAccentuatedNote ? "true" : "false") << "</HeavyAccentuatedNote>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<GhostNote>" << (ghostNote ? "true" : "false") << "</GhostNote>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Slide>" << (slide ? "true" : "false") << "</Slide>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Hammer>" << (hammer ? "true" : "false") << "</Hammer>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<LetRing>" << (letRing ? "true" : "false") << "</LetRing>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<PalmMute>" << (palmMute ? "true" : "false") << "</PalmMute>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Staccato>" << (staccato ? "true" : "false") << "</Staccato>\n";
-	tremoloBar.addToXML(outputStream, indentLevel + 1);
-	tremoloPicking.addToXML(outputStream, indentLevel + 1);
-	bend.addToXML(outputStream, indentLevel + 1);
-	grace.addToXML(outputStream, indentLevel + 1);
-	harmonic.addToXML(outputStream, indentLevel + 1);
-	trill.addToXML(outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<FadeIn>", hasFlag(NOTE_EFFECT_FADE_IN), "</FadeIn>\n");
+	writer.element(indentLevel + 1, "<Vibrato>", hasFlag(NOTE_EFFECT_VIBRATO), "</Vibrato>\n");
+	writer.element(indentLevel + 1, "<Tapping>", hasFlag(NOTE_EFFECT_TAPPING), "</Tapping>\n");
+	writer.element(indentLevel + 1, "<Slapping>", hasFlag(NOTE_EFFECT_SLAPPING), "</Slapping>\n");
+	writer.element(indentLevel + 1, "<Popping>", hasFlag(NOTE_EFFECT_POPPING), "</Popping>\n");
+	writer.element(indentLevel + 1, "<DeadNote>", hasFlag(NOTE_EFFECT_DEAD_NOTE), "</DeadNote>\n");
+	writer.element(indentLevel + 1, "<AccentuatedNote>", hasFlag(NOTE_EFFECT_ACCENTUATED_NOTE), "</AccentuatedNote>\n");
+	writer.element(indentLevel + 1, "<HeavyAccentuatedNote>", hasFlag(NOTE_EFFECT_HEAVY_ACCENTUATED_NOTE), "</HeavyAccentuatedNote>\n");
+	writer.element(indentLevel + 1, "<GhostNote>", hasFlag(NOTE_EFFECT_GHOST_NOTE), "</GhostNote>\n");
+	writer.element(indentLevel + 1, "<Slide>", hasFlag(NOTE_EFFECT_SLIDE), "</Slide>\n");
+	writer.element(indentLevel + 1, "<Hammer>", hasFlag(NOTE_EFFECT_HAMMER), "</Hammer>\n");
+	writer.element(indentLevel + 1, "<LetRing>", hasFlag(NOTE_EFFECT_LET_RING), "</LetRing>\n");
+	writer.element(indentLevel + 1, "<PalmMute>", hasFlag(NOTE_EFFECT_PALM_MUTE), "</PalmMute>\n");
+	writer.element(indentLevel + 1, "<Staccato>", hasFlag(NOTE_EFFECT_STACCATO), "</Staccato>\n");
+	auto& effects = measure.getRareNoteEffects(*this);
+	effects.tremoloBar.addToXML(writer, indentLevel + 1);
+	effects.tremoloPicking.addToXML(writer, indentLevel + 1);
+	effects.bend.addToXML(writer, indentLevel + 1);
+	effects.grace.addToXML(writer, indentLevel + 1);
+	effects.harmonic.addToXML(writer, indentLevel + 1);
+	effects.trill.addToXML(writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Effect>\n";
+	writer.closeTag(indentLevel, "</Effect>\n");
 }
 
-void TremoloBar::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void TremoloBar::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<TremoloBar>\n";
+	writer.openTag(indentLevel, "<TremoloBar>\n");
 
-	addObjectsToXML("Points", points, outputStream, indentLevel + 1);
+	addObjectsToXML("Points", points, writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</TremoloBar>\n";
+	writer.closeTag(indentLevel, "</TremoloBar>\n");
 }
 
-void TremoloPoint::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void TremoloPoint::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<TremoloPoint>\n";
+	writer.openTag(indentLevel, "<TremoloPoint>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<PointPosition>" << pointPosition << "</PointPosition>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<PointValue>" << pointValue << "</PointValue>\n";
+	writer.element(indentLevel + 1, "<PointPosition>", pointPosition, "</PointPosition>\n");
+	writer.element(indentLevel + 1, "<PointValue>", pointValue, "</PointValue>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</TremoloPoint>\n";
+	writer.closeTag(indentLevel, "</TremoloPoint>\n");
 }
 
-void TremoloPicking::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void TremoloPicking::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<TremoloPicking>\n";
+	writer.openTag(indentLevel, "<TremoloPicking>\n");
 
-	duration.addToXML(outputStream, indentLevel + 1);
+	duration.addToXML(writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</TremoloPicking>\n";
+	writer.closeTag(indentLevel, "</TremoloPicking>\n");
 }
 
-void EffectDuration::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void EffectDuration::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<EffectDuration>\n";
+	writer.openTag(indentLevel, "<EffectDuration>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Value>" << value << "</Value>\n";
+	writer.element(indentLevel + 1, "<Value>", value, "</Value>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</EffectDuration>\n";
+	writer.closeTag(indentLevel, "</EffectDuration>\n");
 }
 
-void Bend::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Bend::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Bend>\n";
+	writer.openTag(indentLevel, "<Bend>\n");
 
-	addObjectsToXML("BendPoints", points, outputStream, indentLevel + 1);
+	addObjectsToXML("BendPoints", points, writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Bend>\n";
+	writer.closeTag(indentLevel, "</Bend>\n");
 }
 
-void BendPoint::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void BendPoint::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<BendPoint>\n";
+	writer.openTag(indentLevel, "<BendPoint>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<PointPosition>" << pointPosition << "</PointPosition>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<PointValue>" << pointValue << "</PointValue>\n";
+	writer.element(indentLevel + 1, "<PointPosition>", pointPosition, "</PointPosition>\n");
+	writer.element(indentLevel + 1, "<PointValue>", pointValue, "</PointValue>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</BendPoint>\n";
+	writer.closeTag(indentLevel, "</BendPoint>\n");
 }
 
-void Grace::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Grace::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Grace>\n";
+	writer.openTag(indentLevel, "<Grace>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Fret>" << static_cast<std::uint32_t>(fret) << "</Fret>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Dynamic>" << dynamic << "</Dynamic>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Transition>" << transition << "</Transition>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Duration>" << static_cast<std::uint32_t>(duration) << "</Duration>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Dead>" << (dead ? "true" : "false") << "</Dead>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<OnBeat>" << (onBeat ? "true" : "false") << "</OnBeat>\n";
+	writer.element(indentLevel + 1, "<Fret>", fret, "</Fret>\n");
+	writer.element(indentLevel + 1, "<Dynamic>", dynamic, "</Dynamic>\n");
+	writer.element(indentLevel + 1, "<Transition>", transition, "</Transition>\n");
+	writer.element(indentLevel + 1, "<Duration>", duration, "</Duration>\n");
+	writer.element(indentLevel + 1, "<Dead>", dead, "</Dead>\n");
+	writer.element(indentLevel + 1, "<OnBeat>", onBeat, "</OnBeat>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Grace>\n";
+	writer.closeTag(indentLevel, "</Grace>\n");
 }
 
-void Harmonic::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Harmonic::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Harmonic>\n";
+	writer.openTag(indentLevel, "<Harmonic>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Type>" << type << "</Type>\n";
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Data>" << data << "</Data>\n";
+	writer.element(indentLevel + 1, "<Type>", type, "</Type>\n");
+	writer.element(indentLevel + 1, "<Data>", data, "</Data>\n");
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Harmonic>\n";
+	writer.closeTag(indentLevel, "</Harmonic>\n");
 }
 
-void Trill::addToXML(std::ostringstream& outputStream, std::int32_t indentLevel) const
+void Trill::addToXML(XmlWriter& writer, std::int32_t indentLevel) const
 {
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "<Trill>\n";
+	writer.openTag(indentLevel, "<Trill>\n");
 
-	addSpacingToXML(outputStream, indentLevel + 1);
-	outputStream << "<Fret>" << static_cast<std::int32_t>(fret) << "</Fret>\n";
-	duration.addToXML(outputStream, indentLevel + 1);
+	writer.element(indentLevel + 1, "<Fret>", fret, "</Fret>\n");
+	duration.addToXML(writer, indentLevel + 1);
 
-	addSpacingToXML(outputStream, indentLevel);
-	outputStream << "</Trill>\n";
+	writer.closeTag(indentLevel, "</Trill>\n");
 }
 
 }